@@ -1,6 +1,7 @@
 // Arquivo game.cpp
 // Como compilar: g++ -std=c++17 game.cpp -pthread -lncurses -o semaphore_game
 // Run: ./game
+// Modo headless (benchmark, sem ncurses): g++ -std=c++17 -O2 -DHEADLESS game.cpp -pthread -o bench
 
 /*
 NOME: Gabriel de Araujo Lima​ ​NUSP: 14571376​
@@ -54,12 +55,12 @@ NOME: Wiltord N M NUSP: 15595392
  *
  * 2. COMO AS THREADS INTERAGEM ENTRE SI
  * ---------------------------------------------------------------------------------------------------------
- * - Dados Compartilhados: As threads compartilham a matriz 'map_view' (visualização do jogo), a matriz
- * 'base_map' (lógica imutável) e a variável de controle 'playing'.
+ * - Dados Compartilhados: As threads compartilham a matriz 'map_view' (visualização do jogo), a grade
+ * 'grid' (camadas de parede e terreno, lógica imutável) e a variável de controle 'playing'.
  * - Comunicação: A comunicação é indireta (via estado compartilhado). Um jogador "sabe" onde o outro
  * está ao ler a matriz 'map_view'.
- * - Evitando Condições de Corrida: O acesso à matriz visual é protegido por um Mutex ('mtx_map'). Isso
- * impede que uma thread desenhe a tela enquanto outra está atualizando uma posição (rasgo de tela).
+ * - Evitando Condições de Corrida: O acesso à matriz visual é protegido por Mutexes por região ('map_locks').
+ * Isso impede que uma thread desenhe a tela enquanto outra está atualizando uma posição (rasgo de tela).
  *
  * 3. IMPLEMENTAÇÃO E JUSTIFICATIVA DOS SEMÁFOROS
  * ---------------------------------------------------------------------------------------------------------
@@ -72,7 +73,7 @@ NOME: Wiltord N M NUSP: 15595392
  * 4. SEÇÕES CRÍTICAS PROTEGIDAS
  * ---------------------------------------------------------------------------------------------------------
  * - Região Crítica de DADOS: O acesso às variáveis globais (map_view) dentro de 'move_player'.
- * Protegida por 'std::unique_lock<std::mutex>'.
+ * Protegida pelos mutexes das regiões do mapa ('lock_region' / 'unlock_region').
  * -> Risco Evitado: Corrupção de memória e inconsistência visual (glitches).
  * - Região Crítica LÓGICA: A travessia da ponte ('C'). Protegida por 'sem_trywait' e 'sem_post'.
  * -> Risco Evitado: Dois jogadores ocupando a mesma coordenada física no estreitamento.
@@ -97,9 +98,10 @@ NOME: Wiltord N M NUSP: 15595392
  * 7. DESTAQUES DA IMPLEMENTAÇÃO (VIDE CÓDIGO)
  * ---------------------------------------------------------------------------------------------------------
  * - Criação de Threads: Linhas contendo 'thread t1(...)' na função main.
- * - Entrada na RC: Uso de 'sem_trywait(&sem_RC)' dentro da função 'move_player'.
- * - Saída da RC: Uso de 'sem_post(&sem_RC)' após detectar saída da célula 'C'.
- * - Exclusão Mútua: Blocos 'unique_lock<mutex> lock(mtx_map)' em 'draw_map' e 'move_player'.
+ * - Entrada na RC: Uso de 'sem_trywait(&sem_RC)' em 'BridgeController::try_enter', chamado por 'move_player'.
+ * - Saída da RC: Uso de 'sem_post(&sem_RC)' em 'BridgeController::leave', após detectar saída da célula 'C'.
+ * - Exclusão Mútua: Chamadas 'lock_region' (mutex da região) em 'move_player'. 'draw_map' não trava:
+ * copia o mapa pelo seqlock das regiões ('read_view_snapshot') e refaz a cópia se cruzar com uma escrita.
  *
  * 8. RELAÇÃO ENTRE DESIGN DO JOGO E SISTEMAS OPERACIONAIS
  * ---------------------------------------------------------------------------------------------------------
@@ -107,6 +109,9 @@ NOME: Wiltord N M NUSP: 15595392
  * uma impressora). Os jogadores são PROCESSOS e a ponte é o RECURSO COMPARTILHADO não-preemptível.
  * - Paralelismo: O jogo exige paralelismo para que a competição seja justa (tempo real), tal qual
  * um SO escalona múltiplos processos para dar a ilusão de simultaneidade.
+ * - No modo '--procs' os jogadores são processos de fato (fork): mapa, jogadores, mutexes das regiões e
+ * semáforos das pontes ficam numa 'Match' em memória compartilhada, com sem_init(..., 1, cap)
+ * e mutexes PTHREAD_PROCESS_SHARED + ROBUST.
  *
  */
 
@@ -116,20 +121,54 @@ NOME: Wiltord N M NUSP: 15595392
 #include <semaphore.h>
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <chrono>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#ifndef HEADLESS
 #include <ncurses.h> // Biblioteca para interface textual (TUI)
+#endif
+#include <climits>
+#include <unordered_map>
+#include <map>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>    // Mapas carregados de arquivo via mmap (sem cópia)
+#include <sys/stat.h>
+#include <sys/resource.h> // getrusage: memória de pico no torneio
+#include <sys/epoll.h>   // Multiplexação de eventos (modo --events)
+#include <sys/timerfd.h> // Temporizadores como descritores de arquivo (modo --events)
+#include <sys/socket.h>  // Dump periódico das estatísticas num socket Unix
+#include <sys/un.h>
+#include <sys/wait.h>    // Supervisão dos processos dos jogadores (modo --procs)
+#include <pthread.h>     // Mutexes robustos entre processos (modo --procs)
+#include <csignal>
+#include <cerrno>
+#include <condition_variable>
+#include <functional>
+#if defined(__x86_64__)
+#include <immintrin.h>   // AVX2 nas consultas em lote aos bitboards (escolhido em tempo de execução)
+#endif
 
 using namespace std;
 
 // --- CONFIGURAÇÃO ---
-// Tamanho do Mapa: 21 Linhas x 60 Caracteres (+1 para o terminador nulo \0)
-const int LIN = 21; 
-const int COL = 61; 
+// Mapa padrão: 21 Linhas x 60 Caracteres (+1 para o terminador nulo \0).
+// Outros mapas (até milhares de linhas e colunas) podem ser carregados de arquivo com --map.
+const int DEFAULT_LIN = 21;
+const int DEFAULT_COL = 61;
 
 // --- RECURSOS COMPARTILHADOS 
-/* Matriz constante que serve de modelo para o mapa (chão, paredes, ponte) */
-char base_map[LIN][COL] = {
+/* Matriz constante que serve de modelo para o mapa padrão (chão, paredes, ponte) */
+const char default_map[DEFAULT_LIN][DEFAULT_COL] = {
     "############################################################",
     "#F     #                                            #      #", // F = Bandeira (Alvo) ou Ponto de Partida
     "###### ############################################## #### #",
@@ -153,29 +192,1467 @@ char base_map[LIN][COL] = {
     "############################################################"
 };
 
-/* Matriz visual compartilhada entre as threads e a main para desenho */
-char map_view[LIN][COL];
+/* Tipo de terreno de cada célula, guardado em 2 bits */
+enum Terrain : uint8_t { T_FLOOR = 0, T_BRIDGE = 1, T_FLAG = 2, T_WALL = 3 };
+
+/* Grade lógica do mapa (o antigo base_map), imutável durante a partida.
+ * O texto do mapa fica onde já está (mapa padrão ou mmap do arquivo, sem cópia); as consultas do
+ * jogo usam três bitboards derivados dele, contíguos e por linha (parede, ponte e bandeira, 1 bit
+ * por célula cada). Num mapa de 10k x 10k ocupam 37.5 MB em vez de 100 MB por cópia em char, a
+ * vizinhança de um jogador cabe em poucas linhas de cache e consultas sobre o mapa inteiro
+ * (inundação, alcance da bandeira) operam 64 células por instrução. */
+struct Grid {
+    int rows = 0, cols = 0;       // Dimensões jogáveis
+    size_t stride = 0;            // Bytes por linha no texto (cols + terminador '\0' ou '\n')
+    const char *text = nullptr;   // Texto do mapa, somente leitura
+    size_t text_bytes = 0;
+    bool text_mapped = false;     // true = 'text' é um mmap de arquivo
+    int fd = -1;                  // Descritor do arquivo, mantido aberto para remapear map_view a cada partida
+    string path;                  // Arquivo de origem (vazio = mapa padrão)
+    size_t words = 0;             // Palavras de 64 bits por linha em cada bitboard (bits além de cols = 0)
+    vector<uint64_t> walls;       // Bit (x, y) = 1 se parede
+    vector<uint64_t> bridge_bits; // Bit (x, y) = 1 se ponte ('C')
+    vector<uint64_t> flag_bits;   // Bit (x, y) = 1 se bandeira ('F')
+    int start1_x = -1, start1_y = -1; // Largada do Jogador 1 (bandeira do lado esquerdo)
+    int start2_x = -1, start2_y = -1; // Largada do Jogador 2 (bandeira do lado direito)
+} grid;
+
+/* Consultas à grade. Coordenadas já validadas pelo chamador. */
+static inline bool bit_at(const vector<uint64_t> &layer, int x, int y) {
+    return (layer[(size_t)x * grid.words + (y >> 6)] >> (y & 63)) & 1;
+}
+static inline bool is_wall(int x, int y) { return bit_at(grid.walls, x, y); }
+static inline Terrain terrain_at(int x, int y) {
+    if (is_wall(x, y)) return T_WALL;
+    if (bit_at(grid.bridge_bits, x, y)) return T_BRIDGE;
+    return bit_at(grid.flag_bits, x, y) ? T_FLAG : T_FLOOR;
+}
+/* Caractere do terreno (como no antigo base_map): ' ', 'C', 'F' ou '#' */
+static inline char base_at(int x, int y) {
+    static const char glyph[4] = {' ', 'C', 'F', '#'};
+    return glyph[terrain_at(x, y)];
+}
+
+/* Matriz visual compartilhada entre as threads e a main para desenho.
+ * Mesmo layout do texto do mapa (grid.stride bytes por linha). Para mapas de arquivo é um mmap
+ * privado (copy-on-write) do próprio arquivo: só as páginas onde alguém anda são copiadas. */
+char *map_view = nullptr;
+static vector<char> view_storage; // Armazenamento de map_view para o mapa padrão
+
+static inline char &view_at(int x, int y) {
+    return map_view[(size_t)x * grid.stride + y];
+}
+
+/* Quantos jogadores de cada time ocupam cada célula (2 contadores por célula: time '1' e time '2').
+ * Protegido pelo mesmo mutex de região que a célula em map_view. Com vários bots do mesmo símbolo, a
+ * célula só volta ao terreno quando o último sai; se só restar o outro time, passa a mostrar o outro. */
+static vector<uint16_t> cell_occupants;
+
+static inline uint16_t *occupants_at(int x, int y) {
+    return &cell_occupants[((size_t)x * grid.cols + y) * 2];
+}
+
+/* Um jogador de 'symbol' chega à célula: o último a chegar é o que aparece (Occ: uint16_t aqui, uint8_t na Match) */
+template <class Occ>
+static inline void occupy_cell(Occ *occ, char &cell, char symbol) {
+    occ[symbol == '2']++;
+    cell = symbol;
+}
+
+/* Um jogador de 'symbol' deixa a célula, cujo terreno é 'base' */
+template <class Occ>
+static inline void vacate_cell(Occ *occ, char &cell, char symbol, char base) {
+    int team = symbol == '2';
+    occ[team]--;
+    if (!occ[0] && !occ[1]) cell = base;   // Ninguém mais: restaura o chão (ou a ponte)
+    else if (!occ[team]) cell = team ? '1' : '2'; // Só o outro time ficou: ele reaparece
+}
+
+/* Monta os bitboards a partir do texto e localiza as largadas */
+static void build_grid_layers() {
+    grid.words = ((size_t)grid.cols + 63) / 64;
+    grid.walls.assign(grid.words * grid.rows, 0);
+    grid.bridge_bits.assign(grid.words * grid.rows, 0);
+    grid.flag_bits.assign(grid.words * grid.rows, 0);
+    grid.start1_x = grid.start1_y = grid.start2_x = grid.start2_y = -1;
+    int mid = grid.cols / 2;
+    for (int x = 0; x < grid.rows; x++) {
+        const char *row = grid.text + (size_t)x * grid.stride;
+        size_t base = (size_t)x * grid.words;
+        for (int y = 0; y < grid.cols; y++) {
+            uint64_t bit = 1ULL << (y & 63);
+            switch (row[y]) {
+                case '#': grid.walls[base + (y >> 6)] |= bit; break;
+                case 'C': grid.bridge_bits[base + (y >> 6)] |= bit; break;
+                case 'F':
+                    grid.flag_bits[base + (y >> 6)] |= bit;
+                    if (y < mid && grid.start1_x < 0) { grid.start1_x = x; grid.start1_y = y; } // Primeira bandeira à esquerda
+                    if (y > mid) { grid.start2_x = x; grid.start2_y = y; }                     // Última bandeira à direita
+                    break;
+            }
+        }
+    }
+}
+
+// --- CONSULTAS EM LOTE SOBRE OS BITBOARDS ---
+// Colisão de muitos jogadores de uma vez (AVX2: gather de 4 palavras do bitboard por instrução)
+// e inundação bit-paralela do mapa inteiro (64 células por palavra, 256 por instrução AVX2).
+// O caminho AVX2 é escolhido em tempo de execução; sem ele, ou fora de x86-64, vale o escalar.
+
+bool use_simd = true; // false força o caminho escalar (comparação nos benchmarks)
+
+/* A CPU tem AVX2? (consultado uma vez) */
+static bool cpu_has_avx2() {
+#if defined(__x86_64__)
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+/* blocked[i] = 1 se (xs[i], ys[i]) está fora do mapa ou é parede */
+static void blocked_batch_scalar(const int32_t *xs, const int32_t *ys, size_t n, uint8_t *blocked) {
+    for (size_t i = 0; i < n; i++) {
+        int x = xs[i], y = ys[i];
+        blocked[i] = (unsigned)x >= (unsigned)grid.rows || (unsigned)y >= (unsigned)grid.cols || is_wall(x, y);
+    }
+}
+
+/* Espalha os bits de 'r' pelas sequências de 1 de 'm' rumo aos bits altos / baixos (Kogge-Stone) */
+static inline uint64_t fill_up(uint64_t r, uint64_t m) {
+    r |= m & (r << 1);  m &= m << 1;
+    r |= m & (r << 2);  m &= m << 2;
+    r |= m & (r << 4);  m &= m << 4;
+    r |= m & (r << 8);  m &= m << 8;
+    r |= m & (r << 16); m &= m << 16;
+    return r | (m & (r << 32));
+}
+static inline uint64_t fill_down(uint64_t r, uint64_t m) {
+    r |= m & (r >> 1);  m &= m >> 1;
+    r |= m & (r >> 2);  m &= m >> 2;
+    r |= m & (r >> 4);  m &= m >> 4;
+    r |= m & (r >> 8);  m &= m >> 8;
+    r |= m & (r >> 16); m &= m >> 16;
+    return r | (m & (r >> 32));
+}
+
+/* Fecha a linha 'r' na horizontal: todo chão ligado a um bit de 'r' sem passar por parede */
+static void fill_row(uint64_t *r, const uint64_t *walls, size_t words, uint64_t tail) {
+    uint64_t carry = 0;
+    for (size_t w = 0; w < words; w++) { // Para a direita, com "vai um" entre palavras
+        uint64_t open = ~walls[w] & (w + 1 == words ? tail : ~0ULL);
+        r[w] = fill_up(r[w] | (carry & open), open);
+        carry = r[w] >> 63;
+    }
+    carry = 0;
+    for (size_t w = words; w-- > 0;) { // E de volta para a esquerda
+        uint64_t open = ~walls[w] & (w + 1 == words ? tail : ~0ULL);
+        r[w] = fill_down(r[w] | ((carry << 63) & open), open);
+        carry = r[w] & 1;
+    }
+}
+
+/* r |= src & ~walls (passo vertical da inundação). Retorna true se 'r' ganhou algum bit. */
+static bool spread_scalar(uint64_t *r, const uint64_t *src, const uint64_t *walls, size_t words) {
+    uint64_t grew = 0;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t add = src[w] & ~walls[w] & ~r[w];
+        r[w] |= add;
+        grew |= add;
+    }
+    return grew != 0;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static void blocked_batch_avx2(const int32_t *xs, const int32_t *ys, size_t n, uint8_t *blocked) {
+    const __m128i rows = _mm_set1_epi32(grid.rows), cols = _mm_set1_epi32(grid.cols), neg = _mm_set1_epi32(-1);
+    const __m256i words = _mm256_set1_epi64x((long long)grid.words), c63 = _mm256_set1_epi64x(63);
+    const long long *walls = (const long long *)grid.walls.data();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(xs + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(ys + i));
+        __m128i in = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(rows, x), _mm_cmpgt_epi32(x, neg)),  // 0 <= x < rows
+                                   _mm_and_si128(_mm_cmpgt_epi32(cols, y), _mm_cmpgt_epi32(y, neg))); // 0 <= y < cols
+        __m256i x64 = _mm256_cvtepi32_epi64(_mm_and_si128(x, in)); // Fora do mapa lê a palavra 0 (resultado descartado)
+        __m256i y64 = _mm256_cvtepi32_epi64(_mm_and_si128(y, in));
+        __m256i idx = _mm256_add_epi64(_mm256_mul_epu32(x64, words), _mm256_srli_epi64(y64, 6));
+        __m256i w = _mm256_i64gather_epi64(walls, idx, 8);
+        __m256i bit = _mm256_slli_epi64(_mm256_srlv_epi64(w, _mm256_and_si256(y64, c63)), 63); // Bit da célula no sinal
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(bit)) | (~_mm_movemask_ps(_mm_castsi128_ps(in)) & 15);
+        for (int k = 0; k < 4; k++) blocked[i + k] = (mask >> k) & 1;
+    }
+    blocked_batch_scalar(xs + i, ys + i, n - i, blocked + i); // Resto (menos de 4)
+}
+
+__attribute__((target("avx2")))
+static bool spread_avx2(uint64_t *r, const uint64_t *src, const uint64_t *walls, size_t words) {
+    __m256i grew = _mm256_setzero_si256();
+    size_t w = 0;
+    for (; w + 4 <= words; w += 4) {
+        __m256i cur = _mm256_loadu_si256((const __m256i *)(r + w));
+        __m256i add = _mm256_andnot_si256(cur, _mm256_andnot_si256(_mm256_loadu_si256((const __m256i *)(walls + w)),
+                                                                   _mm256_loadu_si256((const __m256i *)(src + w))));
+        _mm256_storeu_si256((__m256i *)(r + w), _mm256_or_si256(cur, add));
+        grew = _mm256_or_si256(grew, add);
+    }
+    bool tail = spread_scalar(r + w, src + w, walls + w, words - w);
+    return tail || !_mm256_testz_si256(grew, grew);
+}
+#endif
+
+/* Colisão em lote para n destinos (veja blocked_batch_scalar) */
+void blocked_batch(const int32_t *xs, const int32_t *ys, size_t n, uint8_t *blocked) {
+#if defined(__x86_64__)
+    if (use_simd && cpu_has_avx2()) { blocked_batch_avx2(xs, ys, n, blocked); return; }
+#endif
+    blocked_batch_scalar(xs, ys, n, blocked);
+}
+
+/* Inunda o mapa a partir de (sx, sy): 'reach' recebe o bitboard das células alcançáveis.
+ * Varre as linhas para baixo e para cima (passo vertical em lote + fechamento horizontal da
+ * linha) até uma ida e volta sem novidades. Caminhos que só descem ou só sobem fecham numa
+ * varredura; cada mudança de sentido custa no máximo mais uma. Retorna o número de células. */
+size_t flood_fill(int sx, int sy, vector<uint64_t> &reach) {
+    const size_t words = grid.words;
+    const uint64_t tail = grid.cols % 64 ? (1ULL << (grid.cols % 64)) - 1 : ~0ULL; // Bits válidos da última palavra
+    bool (*spread)(uint64_t *, const uint64_t *, const uint64_t *, size_t) = spread_scalar;
+#if defined(__x86_64__)
+    if (use_simd && cpu_has_avx2()) spread = spread_avx2;
+#endif
+    reach.assign(grid.walls.size(), 0);
+    if (sx < 0 || sx >= grid.rows || sy < 0 || sy >= grid.cols || is_wall(sx, sy)) return 0;
+    reach[(size_t)sx * words + (sy >> 6)] = 1ULL << (sy & 63);
+    fill_row(&reach[(size_t)sx * words], &grid.walls[(size_t)sx * words], words, tail);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int pass = 0; pass < 2; pass++) { // 0 = para baixo, 1 = para cima
+            for (int k = 1; k < grid.rows; k++) {
+                int x = pass == 0 ? k : grid.rows - 1 - k, from = pass == 0 ? x - 1 : x + 1;
+                uint64_t *r = &reach[(size_t)x * words];
+                const uint64_t *walls = &grid.walls[(size_t)x * words];
+                if (!spread(r, &reach[(size_t)from * words], walls, words)) continue;
+                fill_row(r, walls, words, tail);
+                changed = true;
+            }
+        }
+    }
+    size_t cells = 0;
+    for (uint64_t w : reach) cells += (size_t)__builtin_popcountll(w);
+    return cells;
+}
+
+/* Existe caminho de (sx, sy) até uma bandeira na metade direita (ou esquerda) do mapa? */
+bool flag_reachable(int sx, int sy, bool target_right) {
+    vector<uint64_t> reach;
+    if (!flood_fill(sx, sy, reach)) return false;
+    int mid = grid.cols / 2;
+    for (size_t i = 0; i < reach.size(); i++) {
+        for (uint64_t hit = reach[i] & grid.flag_bits[i]; hit; hit &= hit - 1) { // Bandeiras alcançadas nesta palavra
+            int y = (int)((i % grid.words) * 64 + (size_t)__builtin_ctzll(hit));
+            if (target_right ? y > mid : y < mid) return true;
+        }
+    }
+    return false;
+}
+
+/* Libera o mapa atual (mmaps e camadas) */
+static void release_map() {
+    if (grid.text_mapped) munmap((void *)grid.text, grid.text_bytes);
+    if (grid.text_mapped && map_view) munmap(map_view, grid.text_bytes);
+    if (grid.fd >= 0) close(grid.fd);
+    map_view = nullptr;
+    grid = Grid();
+}
+
+/* Usa o mapa padrão embutido no programa */
+void use_default_map() {
+    release_map();
+    grid.rows = DEFAULT_LIN;
+    grid.cols = DEFAULT_COL - 1; // A última coluna é o terminador '\0'
+    grid.stride = DEFAULT_COL;
+    grid.text = &default_map[0][0];
+    grid.text_bytes = sizeof(default_map);
+    build_grid_layers();
+}
+
+/* Carrega um mapa de arquivo texto: linhas de mesmo tamanho terminadas em '\n', usando os
+ * mesmos símbolos do mapa padrão. O arquivo é mapeado com mmap, não copiado. */
+bool load_map(const string &path, string &err) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { err = "nao foi possivel abrir " + path; return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); err = "arquivo vazio ou ilegivel: " + path; return false; }
+    size_t bytes = (size_t)st.st_size;
+    void *text = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) { close(fd); err = "mmap falhou: " + path; return false; }
+
+    const char *t = (const char *)text;
+    const char *nl = (const char *)memchr(t, '\n', bytes);
+    size_t stride = nl ? (size_t)(nl - t) + 1 : bytes + 1;
+    size_t rows = (bytes + 1) / stride; // Aceita arquivo sem '\n' na última linha
+    bool ok = stride >= 4 && rows >= 3 && rows <= INT_MAX && stride - 1 <= INT_MAX &&
+              (bytes == rows * stride || bytes + 1 == rows * stride);
+    for (size_t r = 0; ok && r + 1 < rows; r++) ok = t[r * stride + stride - 1] == '\n'; // Todas as linhas com o mesmo tamanho
+    if (!ok) {
+        munmap(text, bytes);
+        close(fd);
+        err = "mapa invalido (linhas de tamanhos diferentes ou menor que 3x3): " + path;
+        return false;
+    }
+
+    release_map();
+    grid.rows = (int)rows;
+    grid.cols = (int)(stride - 1);
+    grid.stride = stride;
+    grid.text = t;
+    grid.text_bytes = bytes;
+    grid.text_mapped = true;
+    grid.fd = fd; // Mesmo arquivo em todas as partidas, ainda que o caminho seja renomeado ou apagado
+    grid.path = path;
+    build_grid_layers();
+    if (grid.start1_x < 0 || grid.start2_x < 0) { // Sem largadas não há partida
+        release_map();
+        err = "mapa sem bandeira 'F' em cada metade (esquerda e direita): " + path;
+        return false;
+    }
+    if (!flag_reachable(grid.start1_x, grid.start1_y, true) || !flag_reachable(grid.start2_x, grid.start2_y, false)) {
+        release_map(); // Partida impossível de vencer
+        err = "bandeira inalcancavel a partir de uma das largadas: " + path;
+        return false;
+    }
+    return true;
+}
+
+/* Recria map_view com o cenário limpo (início de partida) */
+void reset_view() {
+    cell_occupants.assign((size_t)grid.rows * grid.cols * 2, 0); // Ninguém no mapa até place_player
+    if (!grid.text_mapped) {
+        view_storage.assign(grid.text, grid.text + grid.text_bytes); // Copia bytes para clonar mapa. No jogo, prepara estado inicial do cenário.
+        map_view = view_storage.data();
+        return;
+    }
+    if (map_view) munmap(map_view, grid.text_bytes); // Descarta as páginas alteradas na partida anterior
+    void *v = mmap(nullptr, grid.text_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, grid.fd, 0);
+    if (v == MAP_FAILED) { perror("mmap"); exit(1); }
+    map_view = (char *)v;
+}
+
+/* Bytes ocupados pela representação lógica da grade (bitboards) */
+size_t grid_layer_bytes() {
+    return (grid.walls.size() + grid.bridge_bits.size() + grid.flag_bits.size()) * sizeof(uint64_t);
+}
+
+/* Histograma log-linear (estilo HDR) para latências em nanossegundos.
+ * Cada potência de 2 é dividida em 16 sub-faixas: erro relativo < 6.25%, memória fixa (8 KB). */
+struct Histogram {
+    static const int SUB = 16;           // Sub-faixas por potência de 2
+    static const int BUCKETS = 64 * SUB; // Cobre todo o intervalo de uint64_t
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t max_value = 0;
+
+    static int bucket_of(uint64_t v) {
+        if (v < SUB) return (int)v; // Valores pequenos são exatos
+        int msb = 63 - __builtin_clzll(v);                 // Posição do bit mais significativo
+        int sub = (int)((v >> (msb - 4)) & (SUB - 1));     // 4 bits seguintes escolhem a sub-faixa
+        return (msb - 3) * SUB + sub;
+    }
+    static uint64_t bucket_value(int b) { // Limite superior (aproximado) do bucket
+        if (b < SUB) return (uint64_t)b;
+        int msb = b / SUB + 3;
+        uint64_t sub = (uint64_t)(b % SUB);
+        return ((SUB + sub + 1) << (msb - 4)) - 1;
+    }
+    void record(uint64_t v) {
+        counts[bucket_of(v)]++;
+        total++;
+        if (v > max_value) max_value = v;
+    }
+    void merge(const Histogram &o) {
+        for (int i = 0; i < BUCKETS; i++) counts[i] += o.counts[i];
+        total += o.total;
+        if (o.max_value > max_value) max_value = o.max_value;
+    }
+    void record_n(uint64_t v, uint64_t n) { // n amostras de valor v
+        counts[bucket_of(v)] += n;
+        total += n;
+        if (n && v > max_value) max_value = v;
+    }
+    void reset() { *this = Histogram(); }
+    uint64_t percentile(double q) const { // q em [0, 100]
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(q / 100.0 * (double)(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) return min(bucket_value(i), max_value);
+        }
+        return max_value;
+    }
+    /* Imprime o histograma agrupado em potências de 2, com barras proporcionais */
+    void print(ostream &out, const char *unit, uint64_t div) const {
+        uint64_t by_pow[65] = {};
+        for (int i = 0; i < BUCKETS; i++) {
+            if (!counts[i]) continue;
+            uint64_t v = bucket_value(i) / div;
+            by_pow[v ? 64 - __builtin_clzll(v) : 0] += counts[i]; // Faixa [2^(k-1), 2^k)
+        }
+        uint64_t peak = *max_element(by_pow, by_pow + 65);
+        for (int k = 0; k < 65; k++) {
+            if (!by_pow[k]) continue;
+            uint64_t lo = k ? 1ULL << (k - 1) : 0, hi = k ? (1ULL << k) - 1 : 0;
+            out << "  [" << lo << ", " << hi << "] " << unit << ": " << by_pow[k] << " "
+                << string((size_t)(40 * by_pow[k] / peak), '#') << "\n";
+        }
+    }
+};
+
+/* Relógio monotônico em nanossegundos, usado para medir latências */
+static inline uint64_t now_ns() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --- INSTRUMENTAÇÃO ---
+// Contadores e histogramas por thread para a disputa dos mutexes do mapa, rejeições nas pontes,
+// tempo de quadro e latência de movimento. Cada thread escreve só no próprio bloco (alinhado à
+// linha de cache, sem instruções atômicas de leitura-modificação-escrita); quem lê (painel do jogo,
+// dump periódico) soma os blocos de todas as threads. Tempos em ciclos do TSC (rdtsc), convertidos
+// para ns na leitura. Compilar com -DNO_STATS remove toda a coleta (make bench-nostats).
+
+enum StatCounter {
+    S_MOVES,          // Chamadas de move_player (passos tentados)
+    S_MOVED,          // Passos que mudaram a posição
+    S_LOCKS,          // Aquisições dos mutexes do mapa
+    S_LOCK_CONTENDED, // Aquisições que encontraram o mutex ocupado
+    S_BRIDGE_ADMIT,   // sem_trywait bem-sucedidos nas pontes
+    S_BRIDGE_REJECT,  // Tentativas de entrar na ponte barradas (sem vaga, contramão ou fora da vez)
+    S_FRAMES,         // Quadros desenhados
+    S_COUNTERS
+};
+enum StatHist {
+    H_LOCK_WAIT, // Espera por um mutex do mapa
+    H_LOCK_HOLD, // Mutexes do mapa travados por move_player
+    H_DRAW_HOLD, // Mutexes do mapa travados por draw_map (desenho com locks)
+    H_DRAW_COPY, // Cópia otimista do quadro por draw_map (seqlock, sem lock nenhum)
+    H_FRAME,     // draw_map inteiro
+    H_MOVE,      // move_player inteiro (passo de um jogador)
+    H_HISTS
+};
+static const char *const stat_counter_names[S_COUNTERS] = {
+    "moves", "moved", "lock_acquisitions", "lock_contended", "bridge_admitted", "bridge_rejected", "frames"};
+static const char *const stat_hist_names[H_HISTS] = {"lock_wait", "lock_hold", "draw_hold", "draw_copy", "frame", "move"};
+/* 1 a cada N medições entra no histograma. Os caminhos quentes (um passo leva ~200 ns) são
+ * amostrados para que os rdtsc não pesem na vazão; esperas e quadros são raros e caros: todos. */
+static const uint32_t stat_sample_every[H_HISTS] = {1, 16, 1, 1, 1, 16};
+
+/* Relógio barato para a instrumentação: contador de ciclos (x86-64) ou ns do steady_clock */
+static inline uint64_t stat_clock() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return now_ns();
+#endif
+}
+
+/* Bloco de estatísticas de uma thread. Só a dona escreve; leitores usam cargas relaxadas. */
+struct alignas(64) ThreadStats {
+    atomic<uint64_t> counters[S_COUNTERS];
+    atomic<uint64_t> hists[H_HISTS][Histogram::BUCKETS];
+    atomic<uint64_t> hist_max[H_HISTS];
+    atomic<uint64_t> hist_sum[H_HISTS]; // Soma das amostras (ciclos): tempo total esperando, segurando...
+    uint32_t sample_left[H_HISTS]; // Contagem regressiva da amostragem (só a dona usa)
+
+    ThreadStats() {
+        for (auto &c : counters) c.store(0, memory_order_relaxed);
+        for (auto &h : hists) for (auto &b : h) b.store(0, memory_order_relaxed);
+        for (auto &m : hist_max) m.store(0, memory_order_relaxed);
+        for (auto &t : hist_sum) t.store(0, memory_order_relaxed);
+        for (int h = 0; h < H_HISTS; h++) sample_left[h] = stat_sample_every[h];
+    }
+    bool sample(StatHist h) {
+        if (--sample_left[h]) return false;
+        sample_left[h] = stat_sample_every[h];
+        return true;
+    }
+    static void bump(atomic<uint64_t> &a, uint64_t n) { a.store(a.load(memory_order_relaxed) + n, memory_order_relaxed); } // Escritor único
+    void count(StatCounter c) { bump(counters[c], 1); }
+    void record(StatHist h, uint64_t ticks) {
+        bump(hists[h][Histogram::bucket_of(ticks)], 1);
+        bump(hist_sum[h], ticks);
+        if (ticks > hist_max[h].load(memory_order_relaxed)) hist_max[h].store(ticks, memory_order_relaxed);
+    }
+};
+
+/* Registro de todos os blocos. Thread que termina devolve o bloco para reuso (os valores continuam
+ * somando): partidas curtas com threads novas não alocam nem zeram 40 KB por thread. */
+struct StatsRegistry {
+    mutex m;
+    vector<unique_ptr<ThreadStats>> all;
+    vector<ThreadStats *> free_list;
+    uint64_t t0_ns = now_ns(), t0_ticks = stat_clock(); // Calibração do TSC: ciclos por ns desde o início
+
+    double ns_per_tick() const {
+        uint64_t ns = now_ns() - t0_ns, ticks = stat_clock() - t0_ticks;
+        return ns && ticks ? (double)ns / (double)ticks : 1.0;
+    }
+
+    ThreadStats *acquire() {
+        lock_guard<mutex> g(m);
+        if (!free_list.empty()) {
+            ThreadStats *s = free_list.back();
+            free_list.pop_back();
+            return s;
+        }
+        all.emplace_back(new ThreadStats());
+        return all.back().get();
+    }
+    void release(ThreadStats *s) {
+        lock_guard<mutex> g(m);
+        free_list.push_back(s);
+    }
+};
+StatsRegistry &stats_registry() {
+    static StatsRegistry r;
+    return r;
+}
+
+/* Bloco da thread atual: ponteiro thread_local trivial no caminho rápido (sem o invólucro de
+ * inicialização de TLS); no primeiro uso pega um bloco, devolvido quando a thread termina. */
+static thread_local ThreadStats *tls_stats = nullptr;
+
+static ThreadStats &stats_attach() {
+    struct Slot {
+        ThreadStats *s = stats_registry().acquire();
+        ~Slot() {
+            tls_stats = nullptr;
+            stats_registry().release(s);
+        }
+    };
+    thread_local Slot slot;
+    tls_stats = slot.s;
+    return *slot.s;
+}
+
+static inline ThreadStats &stats_local() {
+    ThreadStats *s = tls_stats;
+    return s ? *s : stats_attach();
+}
+
+#ifndef NO_STATS
+const bool stats_enabled = true;
+#define STAT_COUNT(c) stats_local().count(c)
+#define STAT_TIMER(t, h) uint64_t t = stats_local().sample(h) ? stat_clock() : 0 // 0 = fora da amostra
+#define STAT_ELAPSED(h, t) do { if (t) stats_local().record(h, stat_clock() - (t)); } while (0)
+#else
+const bool stats_enabled = false; // Relatórios omitem o que viria dos contadores
+#define STAT_COUNT(c) ((void)0)
+#define STAT_TIMER(t, h) ((void)0)
+#define STAT_ELAPSED(h, t) ((void)0)
+#endif
+
+/* Soma das estatísticas de todas as threads, com tempos em ns */
+struct StatsSnapshot {
+    bool enabled = false;
+    uint64_t t_ns = 0;
+    uint64_t counters[S_COUNTERS] = {};
+    Histogram hists[H_HISTS];
+};
+
+void stats_snapshot(StatsSnapshot &out) {
+    out = StatsSnapshot();
+    out.t_ns = now_ns();
+#ifndef NO_STATS
+    out.enabled = true;
+    StatsRegistry &r = stats_registry();
+    lock_guard<mutex> g(r.m);
+    double ns_per_tick = r.ns_per_tick();
+    for (auto &ts : r.all) {
+        for (int c = 0; c < S_COUNTERS; c++) out.counters[c] += ts->counters[c].load(memory_order_relaxed);
+        for (int h = 0; h < H_HISTS; h++) {
+            for (int b = 0; b < Histogram::BUCKETS; b++) {
+                uint64_t n = ts->hists[h][b].load(memory_order_relaxed);
+                if (n) out.hists[h].record_n((uint64_t)((double)Histogram::bucket_value(b) * ns_per_tick), n);
+            }
+            uint64_t mx = (uint64_t)((double)ts->hist_max[h].load(memory_order_relaxed) * ns_per_tick);
+            out.hists[h].max_value = max(out.hists[h].max_value, mx);
+        }
+    }
+#endif
+}
+
+/* Uma linha "chave=valor" com contadores acumulados e percentis (para máquinas: diff entre linhas) */
+void print_stats_line(ostream &out, const StatsSnapshot &st, uint64_t t0_ns) {
+    out << "t_ms=" << (st.t_ns - t0_ns) / 1000000 << " stats=" << (st.enabled ? "on" : "off");
+    for (int c = 0; c < S_COUNTERS; c++) out << " " << stat_counter_names[c] << "=" << st.counters[c];
+    for (int h = 0; h < H_HISTS; h++) {
+        const Histogram &hg = st.hists[h];
+        out << " " << stat_hist_names[h] << "_p50_ns=" << hg.percentile(50) << " " << stat_hist_names[h]
+            << "_p99_ns=" << hg.percentile(99) << " " << stat_hist_names[h] << "_max_ns=" << hg.max_value;
+    }
+    out << "\n";
+}
+
+/* Escreve uma linha de estatísticas a cada intervalo num arquivo (acrescentando) ou num socket Unix
+ * ("unix:/caminho", SOCK_STREAM; reconecta se o leitor sumir). Roda numa thread própria. */
+class StatsDumper {
+public:
+    bool start(const string &target, long interval_ms) {
+        dest = target;
+        interval = chrono::milliseconds(max(1L, interval_ms));
+        t0 = now_ns();
+        if (dest.compare(0, 5, "unix:") != 0) {
+            file = fopen(dest.c_str(), "a");
+            if (!file) return false;
+        }
+        worker = thread([this] {
+            unique_lock<mutex> lk(m);
+            while (!cv.wait_for(lk, interval, [this] { return stopping; })) dump();
+        });
+        return true;
+    }
+    void stop() { // Última linha com o estado final
+        if (!worker.joinable()) return;
+        {
+            lock_guard<mutex> g(m);
+            stopping = true;
+        }
+        cv.notify_one();
+        worker.join();
+        dump();
+        if (file) fclose(file);
+        if (sock >= 0) close(sock);
+        file = nullptr;
+        sock = -1;
+    }
+    ~StatsDumper() { stop(); }
+
+private:
+    void dump() {
+        StatsSnapshot st;
+        stats_snapshot(st);
+        ostringstream line;
+        print_stats_line(line, st, t0);
+        string text = line.str();
+        if (file) {
+            fwrite(text.data(), 1, text.size(), file);
+            fflush(file);
+            return;
+        }
+        if (sock < 0) { // Conecta (ou reconecta) ao leitor
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, dest.c_str() + 5, sizeof(addr.sun_path) - 1);
+            sock = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (sock >= 0 && connect(sock, (sockaddr *)&addr, sizeof(addr)) != 0) { close(sock); sock = -1; }
+            if (sock < 0) return; // Sem leitor: perde esta linha
+        }
+        if (send(sock, text.data(), text.size(), MSG_NOSIGNAL) != (ssize_t)text.size()) { close(sock); sock = -1; }
+    }
+
+    string dest;
+    chrono::milliseconds interval{1000};
+    uint64_t t0 = 0;
+    FILE *file = nullptr;
+    int sock = -1;
+    thread worker;
+    mutex m;
+    condition_variable cv;
+    bool stopping = false;
+};
+
+string stats_dump_path;        // --stats-dump: arquivo ou "unix:/caminho" (vazio = sem dump)
+long stats_interval_ms = 1000; // --stats-interval-ms: intervalo entre linhas
+
+/* Lê opções do dump de estatísticas comuns ao jogo e ao benchmark. Retorna false se argv[i] não é uma delas. */
+bool parse_stats_option(int argc, char **argv, int &i, bool &ok) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--stats-dump" && has_value) stats_dump_path = argv[++i];
+    else if (arg == "--stats-interval-ms" && has_value) { stats_interval_ms = atol(argv[++i]); ok = stats_interval_ms > 0; }
+    else return false;
+    return true;
+}
+
+/* Inicia o dump pedido em --stats-dump (se houver), reportando o erro */
+bool start_stats_dump(StatsDumper &dumper) {
+    if (stats_dump_path.empty() || dumper.start(stats_dump_path, stats_interval_ms)) return true;
+    cerr << "falha ao abrir " << stats_dump_path << " para as estatisticas\n";
+    return false;
+}
+
+struct DistanceField;
+struct Bot;
+char field_step(DistanceField &f, int x, int y, Bot &b);
+
+/* Controlador automático (bot): decide a próxima direção no lugar do teclado.
+ * Modo RANDOM faz passeio aleatório; SCRIPT segue uma sequência fixa de comandos
+ * ('u', 'd', 'l', 'r') e volta ao passeio aleatório quando o roteiro termina;
+ * FIELD desce o campo de distâncias do seu time até a bandeira. */
+struct Bot {
+    enum Kind { RANDOM, SCRIPT, FIELD } kind = RANDOM;
+    string script;     // Roteiro de comandos (modo SCRIPT)
+    size_t pos = 0;    // Próximo comando do roteiro
+    uint64_t rng = 1;  // Estado do gerador xorshift (nunca zero)
+    DistanceField *field = nullptr; // Campo compartilhado pelo time (modo FIELD)
+
+    uint32_t next_random() {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        return (uint32_t)(rng >> 32);
+    }
+    char decide(int x, int y) { // (x, y) = posição atual do jogador
+        if (kind == FIELD && field) return field_step(*field, x, y, *this);
+        if (kind == SCRIPT && pos < script.size()) return script[pos];
+        return "udlr"[next_random() & 3];
+    }
+    void moved() { if (kind == SCRIPT && pos < script.size()) pos++; } // Avança o roteiro só se o passo aconteceu
+};
+
+/* Comando de movimento com o instante (ns) em que a tecla foi lida */
+struct Command {
+    char dir;      // 'u', 'd', 'l', 'r'
+    uint64_t t_ns; // Carimbo de tempo do getch() (ou da decisão do bot)
+};
+
+/* Política de agrupamento de comandos pendentes na fila de entrada */
+enum Coalesce {
+    COALESCE_NONE,   // Cada tecla vira um movimento (nenhum movimento perdido)
+    COALESCE_LATEST, // Só o comando mais recente importa (descarta os anteriores pendentes)
+    COALESCE_REPEAT  // Repetições consecutivas da mesma direção viram um único movimento
+};
+Coalesce coalesce_policy = COALESCE_NONE;
+
+/* Fila circular limitada, sem lock, de um produtor (main / getch) e um consumidor (thread do jogador).
+ * Substitui o antigo campo 'direction' compartilhado sem sincronização, que perdia teclas
+ * quando chegavam mais rápido que o ritmo de movimento. */
+struct InputQueue {
+    static const uint32_t CAP = 64; // Potência de 2: o índice é mascarado em vez de usar módulo
+    Command buf[CAP];
+    atomic<uint32_t> head{0}; // Próxima posição a ler (escrita só pelo consumidor)
+    atomic<uint32_t> tail{0}; // Próxima posição a escrever (escrita só pelo produtor)
+    uint64_t dropped = 0;     // Comandos descartados por fila cheia (contador do produtor)
+    uint64_t coalesced = 0;   // Comandos absorvidos pela política de agrupamento (contador do consumidor)
+
+    bool push(Command c) { // Chamado apenas pelo produtor
+        uint32_t t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == CAP) { dropped++; return false; } // Cheia
+        buf[t & (CAP - 1)] = c;
+        tail.store(t + 1, memory_order_release); // Publica o comando para o consumidor
+        return true;
+    }
+    bool empty() const {
+        return head.load(memory_order_relaxed) == tail.load(memory_order_acquire);
+    }
+    bool peek(Command &c) const { // Chamado apenas pelo consumidor
+        uint32_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return false;
+        c = buf[h & (CAP - 1)];
+        return true;
+    }
+    void drop_front() { // Chamado apenas pelo consumidor, após um peek bem-sucedido
+        head.store(head.load(memory_order_relaxed) + 1, memory_order_release); // Libera a posição para o produtor
+    }
+    void clear() { // Só com as duas threads paradas (entre partidas)
+        head.store(0); tail.store(0);
+        dropped = coalesced = 0;
+    }
+    /* Retira o próximo comando aplicando a política de agrupamento */
+    bool pop(Command &c, Coalesce policy) {
+        if (!peek(c)) return false;
+        drop_front();
+        Command next;
+        while (policy != COALESCE_NONE && peek(next) &&
+               (policy == COALESCE_LATEST || next.dir == c.dir)) {
+            if (policy == COALESCE_LATEST) c = next; // Fica com o mais recente
+            drop_front();
+            coalesced++;
+        }
+        return true;
+    }
+};
 
 /* Estrutura que define o estado de cada jogador */
 struct Player {
     int x, y;       // Posição atual
     char symbol;    // '1' ou '2'
-    char direction; // Direção do movimento ('u', 'd', 'l', 'r')
+    char direction; // Direção do movimento em execução ('u', 'd', 'l', 'r'), lida e escrita só pela thread do jogador
+    Bot *bot = nullptr;             // Se não nulo, o jogador é controlado por um bot
+    Histogram *move_lat = nullptr;  // Se não nulo, recebe a latência de cada chamada a move_player
+    Histogram *input_lat = nullptr; // Se não nulo, recebe a latência da tecla (getch) até a escrita em map_view
+    InputQueue input;               // Comandos pendentes (main -> thread do jogador)
+    int bridge_ticket = -1;         // Ponte em cuja fila de entrada o jogador espera (-1 = nenhuma)
+    uint64_t attempts = 0;          // Tentativas de movimento nesta partida (contador privado, sem disputa)
+    uint64_t moved = 0;             // Dessas, as que mudaram a posição (idem)
+    uint64_t idle_polls = 0;        // Voltas de thread_player sem comando (acordou só para conferir a fila)
+    /* Estado publicado pela thread do jogador para quem alimenta a fila de fora (--burst): x e y não podem
+     * ser lidos por outra thread enquanto o jogador se move. 'seen' é gravado antes de 'steps' (release). */
+    atomic<uint64_t> seen{0};       // Posição após o último comando processado ((x << 32) | y)
+    atomic<uint32_t> steps{0};      // Comandos processados nesta partida
 };
 
+/* Empacota uma posição no formato de Player::seen */
+inline uint64_t pack_pos(int x, int y) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y; }
+
 // --- VARIÁVEIS GLOBAIS E SINCRONIZAÇÃO ---
 
-/* Define o Mutex para proteção de dados compartilhados (Exclusão Mútua) */
-mutex mtx_map;       // Instancia objeto mutex para proteger acesso à map_view. No jogo, evita condição de corrida no desenho.
+/* Define os Mutexes para proteção de dados compartilhados (Exclusão Mútua).
+ * map_view é dividida em regiões retangulares (tiles), cada uma com seu próprio mutex: jogadores
+ * em regiões diferentes movem em paralelo. Um movimento que cruza a fronteira trava as duas regiões,
+ * sempre em ordem crescente de índice, o que evita deadlock (não há espera circular). */
+struct alignas(64) RegionLock { // Uma linha de cache por região: mutexes vizinhos não disputam a mesma linha
+    mutex m;
+    atomic<uint32_t> seq{0};   // Seqlock da região: ímpar enquanto move_player escreve nela (leitores não travam m)
+    /* Aquisições que encontraram a região ocupada. Só diz onde está a disputa (--regions); os totais ficam
+     * no bloco de estatísticas da thread. Atualizado com o próprio mutex travado, dispensa atômicos. */
+    uint64_t contended = 0;
+};
+unique_ptr<RegionLock[]> map_locks; // Mutexes das regiões, em ordem de linha (índice = ty * tiles_x + tx)
+int tile_rows = 0, tile_cols = 0;   // Tamanho de cada região (--tile RxC; 0 = automático pelo tamanho do mapa)
+int region_rows = 1, region_cols = 1; // Tamanho efetivo das regiões do mapa atual
+int tiles_x = 0, tiles_y = 0;       // Quantidade de regiões em cada direção
+
+/* Protege winner_msg, que pode ser escrita por jogadores em regiões diferentes ao mesmo tempo */
+mutex mtx_winner;
+
+/* Configuração da admissão nas pontes (Regiões Críticas Lógicas 'C') */
+/* Relógio das senhas das pontes. Normalmente é o relógio real, lido só quando uma senha é emitida ou
+ * conferida (a maioria dos passos nem chega perto de uma ponte). A gravação e a reprodução de replays
+ * fixam o instante do movimento em move_clock_ns, para que a reprodução veja o mesmo relógio. */
+thread_local bool move_clock_fixed = false;
+thread_local uint64_t move_clock_ns = 0;
+static inline uint64_t move_clock() { return move_clock_fixed ? move_clock_ns : now_ns(); }
+atomic<uint64_t> bridge_epoch{0}; // Muda a cada entrada/saída/reset de ponte (campos de distância se ressincronizam)
+
+enum BridgeOrder {
+    ORDER_NONE, // Quem tentar primeiro quando houver vaga entra (comportamento original do sem_trywait)
+    ORDER_FIFO  // Senhas por ordem de chegada: só o primeiro da fila pode entrar
+};
+int bridge_capacity = 1;               // Jogadores simultâneos em cada ponte (faixas). 1 = semáforo binário
+BridgeOrder bridge_order = ORDER_FIFO;
+int convoy_batch = 0;                  // > 0: comboios de mesmo sentido, até N admissões furando a fila do sentido oposto
+int bridge_ticket_ttl_ms = 1000;       // Senha sem nova tentativa por esse tempo é descartada (jogador desistiu)
+bool bridge_admission_set = false;     // --bridge-order/--convoy na linha de comando (a Match não os implementa)
+
+/* Controlador de admissão de uma ponte. Cada componente conexo de células 'C' do mapa é uma
+ * Região Crítica independente, com seu próprio semáforo contador (valor inicial = capacidade).
+ * O movimento continua não-bloqueante: quem não pode entrar recebe uma senha e tenta de novo no
+ * próximo ciclo, mas só é admitido na sua vez. */
+struct BridgeController {
+    struct Ticket {
+        const Player *p;
+        char dir;          // Sentido de travessia: a tecla do passo que entra na ponte (ver try_enter)
+        uint64_t t_first;  // Quando a senha foi emitida (início da espera)
+        uint64_t t_last;   // Última tentativa (para descartar senhas abandonadas)
+    };
+
+    int id = 0;                // Índice em 'bridges'
+    sem_t sem_RC;              // Semáforo da Região Crítica: vagas livres na ponte
+    bool sem_ready = false;
+    int capacity = 1;
+    int cells = 0;             // Células 'C' desta ponte
+    vector<size_t> cell_list;  // Índices (x * cols + y) dessas células
+    mutex m;                   // Protege a fila de senhas, a ocupação e as métricas
+    deque<Ticket> waiters;     // Fila de espera por ordem de chegada
+    int occupancy = 0;         // Jogadores dentro da ponte agora
+    char convoy_dir = ' ';     // Sentido do comboio em andamento
+    int convoy_run = 0;        // Admissões no comboio atual
+
+    /* Métricas (acumuladas entre partidas até clear_stats) */
+    int max_occupancy = 0;
+    uint64_t admitted = 0;     // Entradas concedidas
+    uint64_t rejected = 0;     // Tentativas barradas (ponte cheia, contramão ou fora da vez)
+    Histogram wait;            // Espera (ns) da emissão da senha até a admissão
+
+    /* Recomeça a partida: ponte vazia, fila vazia, semáforo com todas as vagas */
+    void reset(int cap) {
+        if (sem_ready) sem_destroy(&sem_RC);
+        capacity = cap;
+        sem_init(&sem_RC, 0, (unsigned)cap); // Cria semáforo contador com 'cap' vagas. No jogo, garante Exclusão Mútua na ponte quando cap = 1.
+        sem_ready = true;
+        waiters.clear();
+        occupancy = 0;
+        convoy_dir = ' ';
+        convoy_run = 0;
+        bridge_epoch.fetch_add(1, memory_order_relaxed);
+    }
+    void destroy() {
+        if (sem_ready) sem_destroy(&sem_RC);
+        sem_ready = false;
+    }
+    void clear_stats() {
+        max_occupancy = 0;
+        admitted = rejected = 0;
+        wait.reset();
+    }
+
+    /* Pode o i-ésimo da fila (sentido dir) entrar agora? Chamado com m travado. */
+    bool eligible(size_t i, char dir) const {
+        if (occupancy >= capacity) return false; // Ponte cheia
+        if (convoy_batch > 0 && occupancy > 0 && dir != convoy_dir) return false; // Contramão: espera o comboio sair
+        if (bridge_order == ORDER_NONE || i == 0) return true;
+        /* Comboio: mesmo sentido do comboio em andamento passa à frente de quem espera no sentido oposto */
+        if (convoy_batch > 0 && occupancy > 0 && dir == convoy_dir && convoy_run < convoy_batch) {
+            for (size_t j = 0; j < i; j++)
+                if (waiters[j].dir == dir) return false; // Dentro do mesmo sentido a ordem de chegada é mantida
+            return true;
+        }
+        return false;
+    }
+
+    /* Tenta admitir p, que ainda está fora da ponte, num passo de tecla dir. Sem esperar: false = tente
+     * no próximo ciclo. O sentido do comboio é a própria tecla, que diz por qual borda da ponte o jogador
+     * entra: quem desce pela ponta de cima é 'd', quem sobe pela de baixo é 'u', e quem entra pela lateral
+     * é 'l'/'r', o mesmo para todos que chegam daquele lado, qualquer que seja a linha. */
+    bool try_enter(Player &p, char dir) {
+        lock_guard<mutex> g(m);
+        uint64_t now = move_clock(); // Instante do movimento (no replay, o gravado)
+        uint64_t ttl = (uint64_t)bridge_ticket_ttl_ms * 1000000;
+        size_t i = 0;
+        while (i < waiters.size()) { // Localiza a senha de p, descartando as abandonadas
+            if (waiters[i].p != &p && now - waiters[i].t_last > ttl) { waiters.erase(waiters.begin() + i); continue; }
+            if (waiters[i].p == &p) break;
+            i++;
+        }
+        if (i == waiters.size()) waiters.push_back({&p, dir, now, now}); // Primeira tentativa: emite a senha
+        Ticket &t = waiters[i];
+        t.t_last = now;
+        t.dir = dir;
+        p.bridge_ticket = id;
+
+        /* Operação WAIT (TryWait) NO SEMÁFORO: só na vez do jogador */
+        if (!eligible(i, dir) || sem_trywait(&sem_RC) != 0) {
+            rejected++;
+            STAT_COUNT(S_BRIDGE_REJECT);
+            return false;
+        }
+        wait.record(now - t.t_first);
+        waiters.erase(waiters.begin() + i);
+        p.bridge_ticket = -1;
+        if (occupancy == 0) { convoy_dir = dir; convoy_run = 0; } // Ponte vazia: começa um novo comboio
+        convoy_run++;
+        occupancy++;
+        bridge_epoch.fetch_add(1, memory_order_relaxed);
+        max_occupancy = max(max_occupancy, occupancy);
+        admitted++;
+        STAT_COUNT(S_BRIDGE_ADMIT);
+        return true;
+    }
+
+    /* p desistiu de entrar (andou para outro lado): libera o lugar na fila */
+    void cancel(Player &p) {
+        lock_guard<mutex> g(m);
+        for (size_t i = 0; i < waiters.size(); i++)
+            if (waiters[i].p == &p) { waiters.erase(waiters.begin() + i); break; }
+        p.bridge_ticket = -1;
+    }
+
+    /* Saída da ponte */
+    void leave() {
+        lock_guard<mutex> g(m);
+        occupancy--;
+        bridge_epoch.fetch_add(1, memory_order_relaxed);
+        /* Operação POST (Signal) NO SEMÁFORO: Libera uma vaga da RC Lógica */
+        sem_post(&sem_RC); // Incrementa semáforo para sinalizar "livre". No jogo, permite que outro jogador entre na ponte.
+    }
+};
+
+vector<unique_ptr<BridgeController>> bridges; // Uma entrada por componente conexo de 'C'
+unordered_map<size_t, int> bridge_cells;     // Ponte de cada célula 'C' (índice x * cols + y); só células de ponte
+
+/* Ponte da célula (x, y), ou -1. A camada de terreno descarta o caso comum sem consultar a tabela. */
+static inline int bridge_at(int x, int y) {
+    if (terrain_at(x, y) != T_BRIDGE) return -1;
+    return bridge_cells.find((size_t)x * grid.cols + y)->second;
+}
+
+/* Identifica as pontes do mapa (componentes conexos de 'C') e cria um controlador para cada */
+void setup_bridges() {
+    for (auto &b : bridges) b->destroy();
+    bridges.clear();
+    bridge_cells.clear();
+    vector<size_t> stack;
+    for (int i = 0; i < grid.rows; i++) {
+        const char *row = grid.text + (size_t)i * grid.stride;
+        for (const char *c = (const char *)memchr(row, 'C', grid.cols); c; // Procura 'C' direto no texto da linha
+             c = (const char *)memchr(c + 1, 'C', (size_t)(row + grid.cols - c - 1))) {
+            int j = (int)(c - row);
+            size_t cell = (size_t)i * grid.cols + j;
+            if (bridge_cells.count(cell)) continue;
+            int id = (int)bridges.size();
+            bridges.emplace_back(new BridgeController());
+            bridges.back()->id = id;
+            stack.assign(1, cell);
+            bridge_cells[cell] = id;
+            while (!stack.empty()) { // Busca em profundidade pelas células 'C' vizinhas
+                size_t cur = stack.back();
+                stack.pop_back();
+                bridges.back()->cells++;
+                bridges.back()->cell_list.push_back(cur);
+                int x = (int)(cur / grid.cols), y = (int)(cur % grid.cols);
+                const int dx[4] = {-1, 1, 0, 0}, dy[4] = {0, 0, -1, 1};
+                for (int k = 0; k < 4; k++) {
+                    int nx = x + dx[k], ny = y + dy[k];
+                    if (nx < 0 || nx >= grid.rows || ny < 0 || ny >= grid.cols) continue;
+                    size_t next = (size_t)nx * grid.cols + ny;
+                    if (terrain_at(nx, ny) != T_BRIDGE || bridge_cells.count(next)) continue;
+                    bridge_cells[next] = id;
+                    stack.push_back(next);
+                }
+            }
+        }
+    }
+}
+
+/* Libera os semáforos de todas as pontes (fim do programa / da medição) */
+void destroy_bridges() {
+    for (auto &b : bridges) b->destroy();
+}
+
+/* Lê opções de admissão das pontes comuns ao jogo e ao benchmark. Retorna false se argv[i] não é uma delas. */
+bool parse_bridge_option(int argc, char **argv, int &i, bool &ok) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--bridge-capacity" && has_value) { bridge_capacity = atoi(argv[++i]); ok = bridge_capacity > 0; }
+    else if (arg == "--bridge-order" && has_value) {
+        string o = argv[++i];
+        ok = o == "fifo" || o == "none";
+        bridge_order = o == "none" ? ORDER_NONE : ORDER_FIFO;
+        bridge_admission_set = true;
+    }
+    else if (arg == "--convoy" && has_value) {
+        convoy_batch = atoi(argv[++i]);
+        ok = convoy_batch >= 0;
+        bridge_admission_set = true;
+    }
+    else return false;
+    return true;
+}
+
+/* Relatório por ponte: ocupação, admissões/rejeições e percentis de espera */
+void print_bridge_stats(ostream &out) {
+    for (auto &bp : bridges) {
+        BridgeController &b = *bp;
+        lock_guard<mutex> g(b.m);
+        out << "bridge=" << b.id << " cells=" << b.cells << " capacity=" << b.capacity
+            << " occupancy=" << b.occupancy << " max_occupancy=" << b.max_occupancy
+            << " admitted=" << b.admitted << " rejected=" << b.rejected
+            << " wait_p50_ns=" << b.wait.percentile(50) << " wait_p90_ns=" << b.wait.percentile(90)
+            << " wait_p99_ns=" << b.wait.percentile(99) << " wait_max_ns=" << b.wait.max_value << "\n";
+    }
+}
+
+// --- CAMPOS DE DISTÂNCIA (BOTS FIELD) ---
+// Um campo guarda, para cada célula, o número de passos até a bandeira mais próxima do lado que o
+// time precisa alcançar (BFS a partir de todas as bandeiras alvo). Todos os bots do time leem o
+// mesmo campo e só comparam os 4 vizinhos: a decisão custa O(1), sem busca por bot.
+// Ponte cheia (semáforo sem vagas) não pode ser atravessada por quem está fora dela; quando a
+// ocupação muda, o campo é reparado só onde o caminho passava pela ponte, em vez de refeito:
+//   - ponte fechou: as células que perderam todos os sucessores (em ordem crescente de distância)
+//     são invalidadas e recebem a distância pelos vizinhos válidos (Dijkstra só nessa área);
+//   - ponte abriu: distâncias menores partem da ponte e se propagam enquanto melhoram.
+// O reparo roda na thread de quem primeiro notar a mudança (try_lock); os demais bots seguem
+// lendo o campo sem bloquear (valores relaxados, no pior caso um passo ruim durante o reparo).
+// Com pontes de uma vaga a ocupação muda a cada travessia, então os reparos têm intervalo mínimo.
+
+static const uint32_t FIELD_INF = UINT32_MAX;
+long field_sync_us = 10000; // Intervalo mínimo entre reparos: uma ponte de uma vaga abre e fecha a cada travessia
 
-/* Define o Semáforo para controle da Região Crítica Lógica (A Ponte) */
-sem_t sem_RC;        // Declara variável semáforo para controlar acesso à ponte. No jogo, limita o acesso a 1 jogador na região crítica.
+struct DistanceField {
+    bool target_right = true;        // Alvo: bandeiras da metade direita (time '1') ou esquerda (time '2')
+    size_t cells = 0;
+    unique_ptr<atomic<uint32_t>[]> dist;
+    /* blocked e epoch só mudam sob m, mas os bots os leem sem lock (enterable, maybe_sync): relaxados, como dist */
+    unique_ptr<atomic<uint8_t>[]> blocked; // Ponte i considerada cheia neste campo
+    size_t nblocked = 0;
+    vector<uint8_t> state;           // Rascunho do reparo por célula (0 = não visitada, 1 = válida, 2 = inválida)
+    atomic<uint64_t> epoch{~0ULL};   // bridge_epoch da última sincronização
+    atomic<uint64_t> last_sync_ns{0};
+    mutex m;                         // Só um reparo por vez
+
+    /* Métricas */
+    uint64_t build_ns = 0;           // Última construção completa
+    uint64_t repairs = 0, repair_ns = 0, repaired_cells = 0;
+
+    /* Fila de prioridade monotônica: células agrupadas por distância (poucas distâncias distintas) */
+    typedef map<uint32_t, vector<uint32_t>> Buckets;
+
+    uint32_t at(size_t c) const { return dist[c].load(memory_order_relaxed); }
+    void set(size_t c, uint32_t d) { dist[c].store(d, memory_order_relaxed); }
+    bool is_blocked(int b) const { return blocked[b].load(memory_order_relaxed); }
+    void set_blocked(int b, bool v) { blocked[b].store(v, memory_order_relaxed); }
+
+    /* Uma entrada por ponte do mapa atual, todas abertas (mantém as marcas se o tamanho já confere) */
+    void size_blocked() {
+        if (nblocked == bridges.size() && blocked) return;
+        nblocked = bridges.size();
+        blocked.reset(new atomic<uint8_t>[nblocked]);
+        for (size_t b = 0; b < nblocked; b++) set_blocked((int)b, false);
+    }
+    /* Considera cheias as mesmas pontes que 'o' (para comparar um reparo com uma construção do zero) */
+    void copy_blocked(const DistanceField &o) {
+        size_blocked();
+        for (size_t b = 0; b < nblocked; b++) set_blocked((int)b, o.is_blocked((int)b));
+    }
+
+    /* Quem está em 'from' pode pisar em 'to' (que não é parede)? Ponte cheia só por dentro. */
+    bool enterable(size_t from, size_t to) const {
+        int tx = (int)(to / grid.cols), ty = (int)(to % grid.cols);
+        if (!bit_at(grid.bridge_bits, tx, ty)) return true;
+        int b = bridge_at(tx, ty);
+        if (!is_blocked(b)) return true;
+        return bridge_at((int)(from / grid.cols), (int)(from % grid.cols)) == b;
+    }
+
+    static bool on_bridge(size_t c) { return bit_at(grid.bridge_bits, (int)(c / grid.cols), (int)(c % grid.cols)); }
+
+    /* Chama f(vizinho) para cada vizinho dentro do mapa e fora de parede */
+    template <class F> static void neighbors(size_t c, F f) {
+        int x = (int)(c / grid.cols), y = (int)(c % grid.cols);
+        if (x > 0 && !is_wall(x - 1, y)) f(c - grid.cols);
+        if (x + 1 < grid.rows && !is_wall(x + 1, y)) f(c + grid.cols);
+        if (y > 0 && !is_wall(x, y - 1)) f(c - 1);
+        if (y + 1 < grid.cols && !is_wall(x, y + 1)) f(c + 1);
+    }
+
+    /* BFS completa a partir das bandeiras alvo, respeitando as pontes em 'blocked' */
+    void build() {
+        uint64_t t0 = now_ns();
+        cells = (size_t)grid.rows * grid.cols;
+        dist.reset(new atomic<uint32_t>[cells]);
+        size_blocked();
+        vector<uint32_t> frontier;
+        int mid = grid.cols / 2;
+        for (size_t c = 0; c < cells; c++) set(c, FIELD_INF);
+        for (size_t i = 0; i < grid.flag_bits.size(); i++) { // Bandeiras alvo = distância 0
+            for (uint64_t bits = grid.flag_bits[i]; bits; bits &= bits - 1) {
+                int x = (int)(i / grid.words), y = (int)((i % grid.words) * 64 + (size_t)__builtin_ctzll(bits));
+                if (target_right ? y <= mid : y >= mid) continue;
+                size_t c = (size_t)x * grid.cols + y;
+                set(c, 0);
+                frontier.push_back((uint32_t)c);
+            }
+        }
+        for (size_t head = 0; head < frontier.size(); head++) {
+            size_t u = frontier[head];
+            uint32_t d = at(u) + 1;
+            bool gate = on_bridge(u); // Fora de ponte todo vizinho pode entrar em u
+            neighbors(u, [&](size_t z) {
+                if (at(z) != FIELD_INF || (gate && !enterable(z, u))) return;
+                set(z, d);
+                frontier.push_back((uint32_t)z);
+            });
+        }
+        build_ns = now_ns() - t0;
+    }
 
-bool playing = true; // Define flag de controle para gerenciar loop principal. No jogo, mantém a execução até ordem de parada.
+    /* Ponte b ficou cheia: invalida e recalcula só quem dependia dela */
+    void block(int b) {
+        set_blocked(b, true);
+        Buckets cand;
+        for (size_t n : bridges[b]->cell_list) { // Quem estava fora e entrava na ponte perdeu esse sucessor
+            if (at(n) == FIELD_INF) continue;
+            neighbors(n, [&](size_t v) {
+                if (at(v) == at(n) + 1 && !enterable(v, n)) cand[at(v)].push_back((uint32_t)v);
+            });
+        }
+        /* Em ordem crescente: uma célula só é inválida se todos os sucessores ficaram inválidos */
+        state.resize(cells, 0);
+        vector<uint32_t> decided, lost;
+        while (!cand.empty()) {
+            uint32_t d = cand.begin()->first;
+            vector<uint32_t> level;
+            level.swap(cand.begin()->second);
+            cand.erase(cand.begin());
+            for (uint32_t w : level) {
+                if (state[w]) continue;
+                bool supported = false;
+                neighbors(w, [&](size_t s) {
+                    if (!supported && at(s) + 1 == d && state[s] != 2 && enterable(w, s)) supported = true;
+                });
+                state[w] = supported ? 1 : 2;
+                decided.push_back(w);
+                if (supported) continue;
+                lost.push_back(w);
+                neighbors(w, [&](size_t z) { // Quem usava w como sucessor vira candidato
+                    if (at(z) == d + 1 && !state[z] && enterable(z, w)) cand[d + 1].push_back((uint32_t)z);
+                });
+            }
+        }
+        for (uint32_t w : decided) state[w] = 0;
+        for (uint32_t w : lost) set(w, FIELD_INF);
+        for (uint32_t w : lost) { // Distância provisória pelos vizinhos que continuaram válidos
+            uint32_t best = FIELD_INF;
+            neighbors(w, [&](size_t s) {
+                if (at(s) != FIELD_INF && enterable(w, s)) best = min(best, at(s) + 1);
+            });
+            if (best == FIELD_INF) continue;
+            set(w, best);
+            cand[best].push_back(w);
+        }
+        relax(cand);
+        repaired_cells += lost.size();
+    }
+
+    /* Ponte b voltou a ter vaga: distâncias menores se propagam a partir dela */
+    void unblock(int b) {
+        set_blocked(b, false);
+        Buckets q;
+        for (size_t n : bridges[b]->cell_list) {
+            if (at(n) == FIELD_INF) continue;
+            neighbors(n, [&](size_t v) {
+                if (at(n) + 1 < at(v) && enterable(v, n)) {
+                    set(v, at(n) + 1);
+                    q[at(v)].push_back((uint32_t)v);
+                }
+            });
+        }
+        repaired_cells += relax(q);
+    }
+
+    /* Dijkstra (pesos 1) a partir das células da fila: baixa a distância de quem pode chegar nelas */
+    size_t relax(Buckets &q) {
+        size_t changed = 0;
+        while (!q.empty()) {
+            uint32_t d = q.begin()->first;
+            vector<uint32_t> level;
+            level.swap(q.begin()->second);
+            q.erase(q.begin());
+            for (uint32_t w : level) {
+                if (d != at(w)) continue; // Entrada velha
+                changed++;
+                bool gate = on_bridge(w);
+                neighbors(w, [&](size_t z) {
+                    if (at(z) > d + 1 && (!gate || enterable(z, w))) {
+                        set(z, d + 1);
+                        q[d + 1].push_back((uint32_t)z);
+                    }
+                });
+            }
+        }
+        return changed;
+    }
+
+    /* Alinha 'blocked' com a ocupação atual das pontes. Chamado com m travado. */
+    void sync() {
+        uint64_t e = bridge_epoch.load(memory_order_acquire);
+        if (e == epoch.load(memory_order_relaxed)) return;
+        uint64_t t0 = now_ns();
+        bool any = false;
+        for (size_t b = 0; b < bridges.size(); b++) {
+            bool full;
+            {
+                lock_guard<mutex> g(bridges[b]->m);
+                full = bridges[b]->occupancy >= bridges[b]->capacity;
+            }
+            if (full == is_blocked((int)b)) continue;
+            if (full) block((int)b);
+            else unblock((int)b);
+            any = true;
+        }
+        epoch.store(e, memory_order_relaxed);
+        if (any) {
+            repairs++;
+            repair_ns += now_ns() - t0;
+        }
+    }
+    /* Ressincroniza se alguma ponte mudou (no máximo a cada field_sync_us), sem nunca esperar por outro reparo */
+    void maybe_sync() {
+        if (bridge_epoch.load(memory_order_relaxed) == epoch.load(memory_order_relaxed)) return; // Sem lock: no pior caso tenta de novo
+        uint64_t now = now_ns();
+        if (now - last_sync_ns.load(memory_order_relaxed) < (uint64_t)field_sync_us * 1000 || !m.try_lock()) return;
+        sync();
+        last_sync_ns.store(now, memory_order_relaxed);
+        m.unlock();
+    }
+};
+
+/* Um campo por time: [0] = time '1' (bandeiras à direita), [1] = time '2' (à esquerda) */
+unique_ptr<DistanceField> team_fields[2];
+
+/* Constrói os campos dos dois times para o mapa e as pontes atuais (depois de reset_map) */
+void setup_fields() {
+    for (int t = 0; t < 2; t++) {
+        team_fields[t].reset(new DistanceField());
+        team_fields[t]->target_right = t == 0;
+        team_fields[t]->build();
+        team_fields[t]->epoch.store(~0ULL, memory_order_relaxed); // Sincroniza com a ocupação no primeiro uso
+    }
+}
+
+/* Próximo passo de um bot FIELD em (x, y): o vizinho alcançável com menor distância (empates sorteados) */
+char field_step(DistanceField &f, int x, int y, Bot &b) {
+    f.maybe_sync();
+    size_t c = (size_t)x * grid.cols + y;
+    const int dx[4] = {-1, 1, 0, 0}, dy[4] = {0, 0, -1, 1};
+    uint32_t best = FIELD_INF, ties = 0;
+    char choice = 0;
+    for (int k = 0; k < 4; k++) {
+        int nx = x + dx[k], ny = y + dy[k];
+        if (nx < 0 || nx >= grid.rows || ny < 0 || ny >= grid.cols || is_wall(nx, ny)) continue;
+        size_t n = (size_t)nx * grid.cols + ny;
+        uint32_t d = f.at(n);
+        if (d == FIELD_INF || d > best || !f.enterable(c, n)) continue;
+        if (d < best) { best = d; ties = 0; }
+        if (b.next_random() % ++ties == 0) choice = "udlr"[k]; // Sorteio uniforme entre empatados
+    }
+    return choice ? choice : "udlr"[b.next_random() & 3]; // Sem caminho agora: passo aleatório
+}
+
+atomic<bool> playing{true}; // Define flag de controle para gerenciar loop principal. No jogo, mantém a execução até ordem de parada.
 string winner_msg = "";
 
+/* Ritmo das threads dos jogadores. O modo headless zera os atrasos para medir o custo puro da sincronização. */
+int move_delay_ms = 100; // Pausa após cada movimento (define a velocidade do jogador)
+int idle_delay_ms = 10;  // Pausa quando não há comando pendente (evita CPU 100%)
+long max_ticks = 0;      // Limite de tentativas de movimento por partida (0 = sem limite; atingido = empate)
+bool end_on_win = true;  // false = a vitória é registrada mas a partida continua (medições de duração fixa)
+atomic<long> ticks{0};   // Tentativas de movimento na partida atual, contadas só quando max_ticks != 0
+
+/* Disputa pelos mutexes do mapa durante um trecho, tirada do bloco de estatísticas de uma ou mais
+ * threads (S_LOCKS, S_LOCK_CONTENDED e a soma de H_LOCK_WAIT). Zerada com -DNO_STATS. */
+struct LockStats {
+    uint64_t acquisitions = 0; // Vezes que o mutex foi adquirido
+    uint64_t contended = 0;    // Aquisições em que o mutex já estava ocupado
+    uint64_t wait_ns = 0;      // Tempo total esperando o mutex
+
+    static LockStats of(const ThreadStats &ts) { // Acumulado da thread até agora
+        LockStats l;
+        l.acquisitions = ts.counters[S_LOCKS].load(memory_order_relaxed);
+        l.contended = ts.counters[S_LOCK_CONTENDED].load(memory_order_relaxed);
+        l.wait_ns = (uint64_t)((double)ts.hist_sum[H_LOCK_WAIT].load(memory_order_relaxed) * stats_registry().ns_per_tick());
+        return l;
+    }
+    void add_delta(const LockStats &end, const LockStats &begin) {
+        acquisitions += end.acquisitions - begin.acquisitions;
+        contended += end.contended - begin.contended;
+        wait_ns += end.wait_ns - begin.wait_ns;
+    }
+};
+
+/* (Re)cria as regiões de lock para o tamanho de tile atual. Só com nenhuma thread usando o mapa. */
+void setup_regions() {
+    /* Automático: 7x16 no mapa padrão (12 regiões); mapas grandes ficam com no máximo ~64x64 regiões */
+    int tr = tile_rows > 0 ? tile_rows : max(7, (grid.rows + 63) / 64);
+    int tc = tile_cols > 0 ? tile_cols : max(16, (grid.cols + 63) / 64);
+    tr = max(1, min(tr, grid.rows));
+    tc = max(1, min(tc, grid.cols));
+    region_rows = tr;
+    region_cols = tc;
+    tiles_y = (grid.rows + tr - 1) / tr;
+    tiles_x = (grid.cols + tc - 1) / tc;
+    map_locks.reset(new RegionLock[tiles_y * tiles_x]);
+}
+
+/* Índice da região que contém a célula (x, y) */
+static inline int region_of(int x, int y) {
+    return (x / region_rows) * tiles_x + y / region_cols;
+}
+
+// --- SNAPSHOTS SEM LOCK (SEQLOCK) ---
+// Leitores do estado (desenho, espectadores) não travam os mutexes das regiões. Cada região tem
+// um contador de sequência que o escritor, já com o mutex da região, torna ímpar antes de mexer no
+// mapa e par de novo depois. O leitor anota os contadores das regiões que vai ler, copia sem lock
+// e confere que nenhum contador mudou; se mudou (ou estava ímpar), refaz a cópia. Escritores nunca
+// esperam por leitores; um leitor só refaz quando cruzou de fato com uma escrita na sua janela.
+// A cópia pode ler bytes em escrita (a corrida é descartada pela conferência), como todo seqlock.
+
+/* Abre a escrita numa região (com o mutex dela travado): contador ímpar */
+static inline void seq_write_begin(atomic<uint32_t> &seq) {
+    seq.store(seq.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // O ímpar fica visível antes de qualquer byte novo
+}
+
+/* Fecha a escrita: contador par, publicando os bytes escritos */
+static inline void seq_write_end(atomic<uint32_t> &seq) {
+    seq.store(seq.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+const uint64_t SEQ_READ_GAVE_UP = ~0ULL; // seq_read desistiu: a cópia não é consistente
+
+/* Leitura otimista das regiões [ty0, ty_end) x [tx0, tx_end): seq_of(r) dá o contador da região r e
+ * copy() copia os dados. Repete até a cópia não cruzar com nenhuma escrita; devolve as repetições, ou
+ * SEQ_READ_GAVE_UP depois de max_retries (um escritor que morreu no meio deixa o contador ímpar). */
+template <class SeqOf, class Copy>
+static uint64_t seq_read(int ty0, int ty_end, int tx0, int tx_end, SeqOf seq_of, Copy copy, uint64_t max_retries = ~0ULL) {
+    thread_local vector<uint32_t> seen;
+    seen.resize((size_t)(ty_end - ty0) * (tx_end - tx0));
+    for (uint64_t retries = 0; retries < max_retries; retries++) {
+        if (retries > 1) this_thread::yield(); // Escritor no meio da escrita (talvez sem CPU): cede a vez
+        bool busy = false;
+        for (int ty = ty0, k = 0; ty < ty_end && !busy; ty++)
+            for (int tx = tx0; tx < tx_end && !busy; tx++, k++) {
+                seen[k] = seq_of(ty * tiles_x + tx).load(memory_order_acquire);
+                busy = seen[k] & 1;
+            }
+        if (busy) continue;
+        copy();
+        atomic_thread_fence(memory_order_acquire); // Os bytes copiados são lidos antes da conferência
+        bool same = true;
+        for (int ty = ty0, k = 0; ty < ty_end && same; ty++)
+            for (int tx = tx0; tx < tx_end && same; tx++, k++) same = seq_of(ty * tiles_x + tx).load(memory_order_relaxed) == seen[k];
+        if (same) return retries;
+    }
+    return SEQ_READ_GAVE_UP;
+}
+
+/* Cópia consistente da janela rows x cols de map_view a partir de (x0, y0) e, se pedido, das posições
+ * dos jogadores, sem travar mutex. As posições só são consistentes com a janela cobrindo o mapa inteiro.
+ * Sem limite de repetições: aqui o escritor é uma thread, e se ela morre o processo inteiro morre junto. */
+uint64_t read_view_snapshot(char *out, int x0, int y0, int rows, int cols, Player *const *players = nullptr, int np = 0,
+                            pair<int, int> *pos = nullptr) {
+    int ty0 = x0 / region_rows, ty_end = (x0 + rows - 1) / region_rows + 1; // Só as regiões que cobrem a janela
+    int tx0 = y0 / region_cols, tx_end = (y0 + cols - 1) / region_cols + 1;
+    return seq_read(ty0, ty_end, tx0, tx_end, [](int r) -> atomic<uint32_t> & { return map_locks[r].seq; }, [&] {
+        for (int i = 0; i < rows; i++) memcpy(out + (size_t)i * cols, &view_at(x0 + i, y0), cols);
+        for (int i = 0; i < np; i++) // x, y são escritos dentro da seção de escrita das duas regiões do passo
+            pos[i] = {__atomic_load_n(&players[i]->x, __ATOMIC_RELAXED), __atomic_load_n(&players[i]->y, __ATOMIC_RELAXED)};
+    });
+}
+
+/* Trava uma região, registrando a disputa quando ela já estava ocupada. Cada evento é contado uma
+ * vez, no bloco da thread; o caminho livre custa só o try_lock e um contador. */
+static void lock_region(int r) {
+    RegionLock &rl = map_locks[r];
+    STAT_COUNT(S_LOCKS);
+    if (rl.m.try_lock()) return; // Caso comum: região livre, sem medir tempo
+    STAT_TIMER(s0, H_LOCK_WAIT);
+    rl.m.lock();
+    STAT_COUNT(S_LOCK_CONTENDED);
+    STAT_ELAPSED(H_LOCK_WAIT, s0); // Só esperas reais: o caminho livre não entra no histograma
+#ifndef NO_STATS
+    rl.contended++;
+#endif
+}
+
+static inline void unlock_region(int r) {
+    map_locks[r].m.unlock();
+}
+
+/* Imprime as k regiões com mais aquisições disputadas (para ajustar o tamanho do tile) */
+void print_region_stats(ostream &out, int k) {
+    int n = tiles_y * tiles_x;
+    vector<int> order(n);
+    for (int r = 0; r < n; r++) order[r] = r;
+    sort(order.begin(), order.end(), [](int a, int b) { return map_locks[a].contended > map_locks[b].contended; });
+    for (int i = 0; i < min(k, n); i++) {
+        const RegionLock &rl = map_locks[order[i]];
+        out << "  region=" << order[i] << " rows=" << (order[i] / tiles_x) * region_rows
+            << " cols=" << (order[i] % tiles_x) * region_cols
+            << " contended=" << rl.contended << "\n";
+    }
+}
+
+/* Lê "RxC" (ex.: "7x16") como tamanho de tile */
+bool parse_tile(const string &text, int &rows, int &cols) {
+    return sscanf(text.c_str(), "%dx%d", &rows, &cols) == 2 && rows > 0 && cols > 0;
+}
+
 // --- FUNÇÕES ---
 
+#ifndef HEADLESS
 /* Inicializa a biblioteca ncurses e configura cores/teclado */
 void init_interface() {
     initscr();            // Inicia ncurses para preparar o terminal. No jogo, permite desenho gráfico avançado.
@@ -197,141 +1674,1429 @@ void init_interface() {
 void close_interface() {
     endwin(); // Finaliza ncurses para restaurar o terminal original. No jogo, evita que terminal fique "bugado" ao sair.
 }
+#endif // HEADLESS
+
+// --- RENDERIZAÇÃO INCREMENTAL (DELTA) ---
+// O desenho copia map_view sob o mutex (seção crítica curta, só um memcpy), solta o lock e
+// compara a cópia com o último quadro desenhado. Apenas células alteradas são enviadas ao
+// ncurses, agrupadas em trechos contíguos da mesma cor (um attron/attroff por trecho).
+
+/* Contadores da renderização, para verificar a redução de trabalho por quadro */
+struct RenderStats {
+    uint64_t frames = 0;      // Quadros desenhados
+    uint64_t cells = 0;       // Células redesenhadas (total)
+    uint64_t bytes = 0;       // Bytes entregues ao ncurses: caracteres + trocas de atributo (total)
+    uint64_t last_cells = 0;  // Células redesenhadas no último quadro
+    uint64_t last_bytes = 0;  // Bytes entregues no último quadro
+    Histogram copy;           // Tempo (ns) da cópia do quadro: posse das regiões, ou cópia otimista se snapshot_reads
+    uint64_t retries = 0;     // Cópias refeitas por cruzarem com uma escrita (snapshot_reads)
+} render_stats;
+
+bool snapshot_reads = true; // O desenho copia o mapa pelo seqlock; false = trava as regiões (comportamento original)
+int view_rows = INT_MAX, view_cols = INT_MAX; // Tamanho da janela desenhada (no jogo, o tamanho do terminal)
+static int frame_rows = 0, frame_cols = 0;     // Janela efetiva do quadro atual
+static int frame_x0 = 0, frame_y0 = 0;         // Canto superior esquerdo da janela no mapa (segue os jogadores)
+Player *const *camera_players = nullptr;        // Jogadores que a janela acompanha (nulo = canto fixo em 0, 0)
+int camera_n = 0;
+static vector<char> frame_prev; // Último quadro efetivamente desenhado (frame_rows x frame_cols)
+static vector<char> frame_next; // Cópia de map_view tirada neste quadro
+static bool frame_valid = false; // false = próximo quadro redesenha tudo
+
+/* Força o próximo quadro a redesenhar a tela inteira (nova partida, tela limpa) */
+void invalidate_frame() {
+    frame_valid = false;
+    frame_rows = min(view_rows, grid.rows);
+    frame_cols = min(view_cols, grid.cols);
+    frame_x0 = frame_y0 = 0;
+    frame_prev.assign((size_t)frame_rows * frame_cols, 0);
+    frame_next.assign((size_t)frame_rows * frame_cols, 0);
+}
+
+/* Desloca a janela para manter os jogadores à vista num mapa maior que o terminal. Só rola quando alguém
+ * chega a menos de 1/4 da janela da borda (rolar redesenha a tela inteira); se os jogadores não cabem
+ * juntos na janela, acompanha o primeiro. */
+void follow_positions(const pair<int, int> *pos, int n) {
+    if (n <= 0) return;
+    auto axis = [](int lo, int hi, int first, int size, int total, int &origin) {
+        if (size >= total) return;
+        int margin = size / 4;
+        if (hi - lo > size - 1 - 2 * margin) lo = hi = first;
+        if (lo < origin + margin) origin = lo - margin;
+        if (hi > origin + size - 1 - margin) origin = hi - size + 1 + margin;
+        origin = max(0, min(origin, total - size));
+    };
+    int x_lo = pos[0].first, x_hi = x_lo, y_lo = pos[0].second, y_hi = y_lo;
+    for (int i = 1; i < n; i++) {
+        x_lo = min(x_lo, pos[i].first); x_hi = max(x_hi, pos[i].first);
+        y_lo = min(y_lo, pos[i].second); y_hi = max(y_hi, pos[i].second);
+    }
+    int x0 = frame_x0, y0 = frame_y0;
+    axis(x_lo, x_hi, pos[0].first, frame_rows, grid.rows, x0);
+    axis(y_lo, y_hi, pos[0].second, frame_cols, grid.cols, y0);
+    if (x0 == frame_x0 && y0 == frame_y0) return;
+    frame_x0 = x0;
+    frame_y0 = y0;
+    frame_valid = false; // Tudo mudou de lugar na tela
+}
+
+/* Acompanha camera_players pela posição que cada thread de jogador publica (x, y são só dela) */
+static void follow_camera() {
+    if (!camera_players || (frame_rows >= grid.rows && frame_cols >= grid.cols)) return;
+    pair<int, int> pos[2];
+    int n = min(camera_n, 2);
+    for (int i = 0; i < n; i++) {
+        uint64_t at = camera_players[i]->seen.load(memory_order_relaxed);
+        pos[i] = {(int)(at >> 32), (int)(uint32_t)at};
+    }
+    follow_positions(pos, n);
+}
+
+/* Par de cor usado para cada tipo de célula (0 = sem cor) */
+static inline int color_of(char cell) {
+    switch (cell) {
+        case '1': return 1; // Jogador 1
+        case '2': return 2; // Jogador 2
+        case '#': return 3; // Parede
+        case 'C': return 4; // Ponte (Região Crítica)
+        case 'F': return 5; // Bandeira
+        default:  return 0;
+    }
+}
+
+/* Envia ao terminal um trecho de células da mesma cor */
+static void emit_run(int row, int col, const char *cells, int len, int color) {
+#ifndef HEADLESS
+    if (color) attron(COLOR_PAIR(color)); // Uma troca de atributo por trecho, não por célula
+    mvaddnstr(row, col, cells, len);
+    if (color) attroff(COLOR_PAIR(color));
+#else
+    (void)row; (void)col; (void)cells;
+#endif
+    render_stats.last_cells += len;
+    render_stats.last_bytes += len + (color ? 2 : 0);
+}
+
+#ifndef HEADLESS
+/* Painel de instrumentação no canto superior direito (tecla 'i'). Recalculado no máximo a cada
+ * 250 ms; entre recálculos só é redesenhado por cima das células que o delta alterou. */
+static bool stats_overlay_on = false;
+static vector<string> stats_overlay_lines;
+static uint64_t stats_overlay_t = 0;
+
+void toggle_stats_overlay() {
+    stats_overlay_on = !stats_overlay_on;
+    stats_overlay_t = 0;
+    if (!stats_overlay_on) invalidate_frame(); // Próximo quadro redesenha o mapa por baixo do painel
+}
+
+/* Se definida, gera as linhas do painel no lugar das estatísticas das threads deste processo. No modo
+ * --procs os jogadores são outros processos: os contadores deles só existem no segmento compartilhado. */
+function<void(vector<string> &)> stats_overlay_source;
+
+static bool draw_stats_overlay() {
+    if (!stats_overlay_on) return false;
+    uint64_t now = now_ns();
+    bool fresh = now - stats_overlay_t >= 250000000ULL;
+    if (fresh && stats_overlay_source) {
+        stats_overlay_lines.clear();
+        stats_overlay_source(stats_overlay_lines);
+        stats_overlay_t = now;
+    } else if (fresh) {
+        StatsSnapshot st;
+        stats_snapshot(st);
+        stats_overlay_lines.clear();
+        char buf[96];
+        if (!st.enabled) stats_overlay_lines.push_back(" instrumentacao desligada (NO_STATS) ");
+        snprintf(buf, sizeof buf, " locks %llu  disputados %llu ", (unsigned long long)st.counters[S_LOCKS],
+                 (unsigned long long)st.counters[S_LOCK_CONTENDED]);
+        stats_overlay_lines.push_back(buf);
+        snprintf(buf, sizeof buf, " ponte: admitidos %llu  barrados %llu ", (unsigned long long)st.counters[S_BRIDGE_ADMIT],
+                 (unsigned long long)st.counters[S_BRIDGE_REJECT]);
+        stats_overlay_lines.push_back(buf);
+        for (int h = 0; h < H_HISTS; h++) {
+            snprintf(buf, sizeof buf, " %-9s p50 %6lluns p99 %7lluns ", stat_hist_names[h],
+                     (unsigned long long)st.hists[h].percentile(50), (unsigned long long)st.hists[h].percentile(99));
+            stats_overlay_lines.push_back(buf);
+        }
+        stats_overlay_t = now;
+    }
+    if (!fresh && !render_stats.last_cells) return false; // Nada mudou por baixo nem no painel
+    size_t width = 0;
+    for (auto &l : stats_overlay_lines) width = max(width, l.size());
+    int col = max(0, COLS - (int)width);
+    attron(A_REVERSE);
+    for (size_t i = 0; i < stats_overlay_lines.size() && (int)i < LINES; i++) {
+        string line = stats_overlay_lines[i];
+        line.resize(width, ' '); // Largura uniforme: cobre o mapa por baixo
+        mvaddnstr((int)i, col, line.c_str(), (int)width);
+    }
+    attroff(A_REVERSE);
+    return fresh; // Sem recálculo, o refresh já vem do delta
+}
+#endif // HEADLESS
+
+/* Desenha frame_next (já copiado) comparando com o último quadro: só o que mudou vai ao terminal */
+void present_frame() {
+    render_stats.last_cells = 0;
+    render_stats.last_bytes = 0;
+    for (int i = 0; i < frame_rows; i++) {
+        const char *next = &frame_next[(size_t)i * frame_cols];
+        const char *prev = &frame_prev[(size_t)i * frame_cols];
+        int j = 0;
+        while (j < frame_cols) {
+            if (frame_valid && next[j] == prev[j]) { j++; continue; } // Célula igual ao quadro anterior: nada a fazer
+            int start = j;
+            int color = color_of(next[j]);
+            /* Estende o trecho enquanto as células mudaram e têm a mesma cor */
+            while (j < frame_cols && (!frame_valid || next[j] != prev[j]) && color_of(next[j]) == color) j++;
+            emit_run(i, start, &next[start], j - start, color);
+        }
+    }
+    frame_prev.swap(frame_next); // O quadro atual passa a ser a referência do próximo diff
+    frame_valid = true;
+
+    render_stats.frames++;
+    render_stats.cells += render_stats.last_cells;
+    render_stats.bytes += render_stats.last_bytes;
+#ifndef HEADLESS
+    bool overlay = draw_stats_overlay(); // Painel de instrumentação (tecla 'i') por cima do quadro
+    if (render_stats.last_cells || overlay) refresh(); // Atualiza tela real apenas se algo mudou. No jogo, o usuário vê o quadro desenhado.
+#endif
+}
+
+/* Função responsável por desenhar o estado atual do jogo na tela */
+void draw_map() {
+    STAT_TIMER(s_frame, H_FRAME);
+    follow_camera();
+    if (snapshot_reads) { // Cópia otimista: os jogadores não esperam pelo desenho
+        STAT_TIMER(s_copy, H_DRAW_COPY);
+        uint64_t t0 = now_ns();
+        render_stats.retries += read_view_snapshot(frame_next.data(), frame_x0, frame_y0, frame_rows, frame_cols);
+        render_stats.copy.record(now_ns() - t0);
+        STAT_ELAPSED(H_DRAW_COPY, s_copy);
+    } else {
+        /* Início da Seção Crítica de Leitura: apenas a cópia do mapa acontece com o mutex travado */
+        int ty0 = frame_x0 / region_rows, ty_end = (frame_x0 + frame_rows - 1) / region_rows + 1; // Só as regiões que cobrem a janela
+        int tx0 = frame_y0 / region_cols, tx_end = (frame_y0 + frame_cols - 1) / region_cols + 1;
+        for (int ty = ty0; ty < ty_end; ty++) // Trava em ordem crescente de índice (mesma ordem de move_player: sem deadlock)
+            for (int tx = tx0; tx < tx_end; tx++) lock_region(ty * tiles_x + tx);
+        STAT_TIMER(s_hold, H_DRAW_HOLD); // Posse, não espera: começa com todas as regiões já travadas
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < frame_rows; i++) // Copia o quadro (1260 bytes no mapa padrão). No jogo, jogadores voltam a mover logo em seguida.
+            memcpy(&frame_next[(size_t)i * frame_cols], &view_at(frame_x0 + i, frame_y0), frame_cols);
+        STAT_ELAPSED(H_DRAW_HOLD, s_hold);
+        for (int ty = ty_end - 1; ty >= ty0; ty--)
+            for (int tx = tx_end - 1; tx >= tx0; tx--) unlock_region(ty * tiles_x + tx);
+        render_stats.copy.record(now_ns() - t0);
+    }
+
+    present_frame();
+    STAT_COUNT(S_FRAMES);
+    STAT_ELAPSED(H_FRAME, s_frame);
+}
+
+/* Verifica se o movimento para (nx, ny) é válido */
+bool allow_move(int nx, int ny) {
+    if (nx < 0 || nx >= grid.rows || ny < 0 || ny >= grid.cols) return false; // Checa limites para validar coordenadas. No jogo, impede segfault ou saída do mapa.
+    if (is_wall(nx, ny)) return false; // Checa o bit de parede para verificar colisão sólida. No jogo, impede atravessar obstáculos.
+    return true; // Retorna true para confirmar validade. No jogo, permite o movimento.
+}
+
+/* Lógica principal de movimento, colisão e sincronização, comum ao jogo clássico (estado em globais)
+ * e à Match (segmento compartilhado ou vaga de arena). W diz onde fica o estado da partida:
+ *   lock(r) / unlock(r) / seq(r)    mutex e seqlock da região r
+ *   view(x, y) / occupants(x, y)   célula do mapa visual e jogadores de cada time nela
+ *   enter_bridge(b, dir)           admissão na ponte b por um passo dir (false = tente no próximo ciclo)
+ *   off_bridge()                   o passo não entra em ponte (desiste de uma senha pendente)
+ *   leave_bridge(b)                saída da ponte b, depois de soltar as regiões
+ *   win()                          p chegou à bandeira do outro lado
+ *   stepping(nx, ny)               célula antiga já liberada, a nova ainda não ocupada
+ * Retorna true se o jogador de fato mudou de posição. */
+template <class W, class P>
+bool apply_move(W &w, P &p, char dir) {
+    STAT_COUNT(S_MOVES);
+    int nx = p.x; // Cria cópia local de X para cálculo. No jogo, prepara nova posição.
+    int ny = p.y; // Cria cópia local de Y para cálculo. No jogo, prepara nova posição.
+
+    /* Calcula a nova coordenada baseada na direção */
+    switch (dir) {
+        case 'u': nx--; break; // Decrementa X para mover para cima. No jogo, define destino do movimento.
+        case 'd': nx++; break; // Incrementa X para mover para baixo. No jogo, define destino do movimento.
+        case 'l': ny--; break; // Decrementa Y para mover para esquerda. No jogo, define destino do movimento.
+        case 'r': ny++; break; // Incrementa Y para mover para direita. No jogo, define destino do movimento.
+        default: return false; // Caso padrão para ignorar input inválido. No jogo, não faz nada.
+    }
+
+    if (!allow_move(nx, ny)) return false; // Chama validação para verificar permissão. No jogo, aborta se for parede.
+
+    /* Entrada na Seção Crítica de DADOS: Solicita acesso exclusivo às regiões de origem e destino */
+    int r_from = region_of(p.x, p.y); // Região onde o jogador está
+    int r_to = region_of(nx, ny);     // Região para onde vai (pode ser a mesma)
+    int r_first = min(r_from, r_to), r_second = max(r_from, r_to);
+    w.lock(r_first); // Trava sempre a de menor índice primeiro. No jogo, dois jogadores cruzando a fronteira em sentidos opostos não travam um ao outro.
+    if (r_second != r_first) w.lock(r_second);
+    STAT_TIMER(s_hold, H_LOCK_HOLD);
+    auto unlock_both = [&] {
+        STAT_ELAPSED(H_LOCK_HOLD, s_hold); // Tempo com as regiões travadas por este passo
+        if (r_second != r_first) w.unlock(r_second);
+        w.unlock(r_first);
+    };
+
+    char next_base = base_at(nx, ny);      // Lê terreno futuro para lógica. No jogo, identifica se é ponte ou chão.
+    char current_base = base_at(p.x, p.y); // Lê terreno atual para lógica. No jogo, usado para apagar rastro.
+
+    // --- LÓGICA DO SEMÁFORO (Região Crítica do Jogo) ---
+    int b_next = bridge_at(nx, ny);  // Ponte do destino (-1 = fora de ponte)
+    int b_cur = bridge_at(p.x, p.y); // Ponte atual
+    /* Verifica se está entrando numa Ponte ('C') vindo de fora */
+    if (b_next >= 0 && b_next != b_cur) {
+        if (!w.enter_bridge(b_next, dir)) { // Tenta entrar na RC Lógica. No jogo, se não for a vez ou não houver vaga, jogador é impedido de entrar.
+            unlock_both();
+            return false; // Retorna erro para cancelar função. No jogo, o personagem "bate" na entrada e espera.
+        }
+    } else {
+        w.off_bridge(); // Andou para outro lado: desiste da fila da ponte.
+    }
+    // ----------------------------------------------------
+
+    /* Verificação de Vitória */
+    int mid_col = grid.cols / 2; // Calcula meio do mapa para definir fronteira. No jogo, separa os lados de vitória.
+    if (next_base == 'F' && (p.symbol == '1' ? ny > mid_col : ny < mid_col)) w.win(); // Bandeira do outro lado. No jogo, define fim da partida.
+
+    /* Flag auxiliar para saber se deve liberar o semáforo depois */
+    bool just_exited_critical = (b_cur >= 0 && b_next != b_cur); // Avalia saída para lógica booleana. No jogo, true se saiu da ponte agora.
+
+    /* Atualização Visual do Mapa (Memória Compartilhada) */
+    seq_write_begin(w.seq(r_first)); // Leitores sem lock que cruzarem com esta escrita refazem a cópia
+    if (r_second != r_first) seq_write_begin(w.seq(r_second));
+    // A célula antiga só volta ao terreno se nenhum outro jogador (companheiro de time inclusive) ficou nela.
+    vacate_cell(w.occupants(p.x, p.y), w.view(p.x, p.y), p.symbol, current_base); // No jogo, apaga o rastro do jogador.
+    w.stepping(nx, ny);
+    p.x = nx; // Atualiza struct X para efetivar valor. No jogo, jogador muda de posição lógica.
+    p.y = ny; // Atualiza struct Y para efetivar valor. No jogo, jogador muda de posição lógica.
+    
+    // Desenha jogador na nova posição (isso pode sobrescrever o outro jogador: último escritor vence - permite ultrapassar)
+    occupy_cell(w.occupants(p.x, p.y), w.view(p.x, p.y), p.symbol); // Escreve na matriz para renderizar. No jogo, atualiza a posição visual.
+    if (r_second != r_first) seq_write_end(w.seq(r_second));
+    seq_write_end(w.seq(r_first));
+
+    unlock_both();
+    /* Saída da Seção Crítica de DADOS: Libera os mutexes das regiões para permitir desenho */
+
+    if (just_exited_critical) {
+        w.leave_bridge(b_cur); // Operação POST no semáforo da ponte. No jogo, permite que outro jogador entre na ponte.
+    }
+    STAT_COUNT(S_MOVED);
+    return true;
+}
+
+/* Estado do jogo clássico para apply_move: globais map_view, map_locks e bridges */
+struct GlobalWorld {
+    Player &p;
+    void lock(int r) { lock_region(r); }
+    void unlock(int r) { unlock_region(r); }
+    atomic<uint32_t> &seq(int r) { return map_locks[r].seq; }
+    char &view(int x, int y) { return view_at(x, y); }
+    uint16_t *occupants(int x, int y) { return occupants_at(x, y); }
+    /* Pede admissão ao controlador da ponte: senha na fila + sem_trywait no semáforo da região */
+    bool enter_bridge(int b, char dir) { return bridges[b]->try_enter(p, dir); }
+    void off_bridge() {
+        if (p.bridge_ticket >= 0) bridges[p.bridge_ticket]->cancel(p);
+    }
+    void leave_bridge(int b) { bridges[b]->leave(); }
+    void stepping(int, int) {} // Threads não morrem sozinhas: o passo sempre termina
+    void win() {
+        lock_guard<mutex> g(mtx_winner);
+        if (end_on_win) playing = false; // Seta flag false para sinalizar parada. No jogo, encerra o loop principal.
+        winner_msg = p.symbol == '1' ? "PLAYER 1 VENCEU!" : "PLAYER 2 VENCEU!"; // Define string para output. No jogo, anuncia o vencedor.
+    }
+};
+
+/* Passo do jogador p na direção p.direction, no jogo clássico */
+bool move_player(Player &p) {
+    GlobalWorld w{p};
+    return apply_move(w, p, p.direction);
+}
+
+// --- REPLAY (GRAVAÇÃO) ---
+// Uma partida é reproduzível se soubermos quais comandos chegaram ao move_player, em que ordem e
+// em que instante (o relógio das senhas das pontes). O gravador serializa os movimentos da
+// partida (um mutex em volta de move_player; com 100 ms entre passos a disputa é desprezível) e
+// anota cada um como delta compacto. Formato (inteiros em varint LEB128, salvo indicação):
+//   cabeçalho: "RSR1", hash FNV-1a do mapa (8 bytes LE), semente, nº de jogadores,
+//              capacidade da ponte, ordem da ponte, comboio, validade das senhas (ms)
+//   eventos:   chave = 1 + jogador * 4 + direção (0 = fim), delta do instante em us
+//   rodapé:    movimentos efetivos, (x, y) final de cada jogador, hash do map_view (8 bytes LE),
+//              tamanho + bytes do winner_msg
+
+/* Inteiro sem sinal em varint (7 bits por byte, bit alto = continua) */
+static void put_varint(vector<uint8_t> &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+static bool get_varint(const uint8_t *&in, const uint8_t *end, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        uint8_t b = *in++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false; // Truncado ou longo demais
+}
+static void put_u64(vector<uint8_t> &out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+static bool get_u64(const uint8_t *&in, const uint8_t *end, uint64_t &v) {
+    if (end - in < 8) return false;
+    v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)*in++ << (8 * i);
+    return true;
+}
+
+/* FNV-1a de 'rows' linhas de 'cols' bytes, espaçadas de 'stride' (texto do mapa ou map_view) */
+static uint64_t hash_rows(const char *text, int rows, int cols, size_t stride) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int x = 0; x < rows; x++) {
+        const char *row = text + (size_t)x * stride;
+        for (int y = 0; y < cols; y++) h = (h ^ (uint8_t)row[y]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+uint64_t map_hash() { return hash_rows(grid.text, grid.rows, grid.cols, grid.stride); }
+uint64_t view_hash() { return hash_rows(map_view, grid.rows, grid.cols, grid.stride); }
+
+static int dir_code(char d) { return d == 'u' ? 0 : d == 'd' ? 1 : d == 'l' ? 2 : 3; }
+
+/* Grava os movimentos de uma partida. Ligado por --record; nullptr = sem gravação. */
+struct ReplayRecorder {
+    vector<Player *> players; // Índice do jogador no arquivo = posição aqui
+    vector<uint8_t> buf;
+    mutex m;
+    uint64_t last_us = 0;
+    uint64_t moves = 0;
+
+    /* Começa uma partida (depois de reset_match) */
+    void begin(vector<Player *> ps, uint64_t seed) {
+        players = move(ps);
+        buf.assign({'R', 'S', 'R', '1'});
+        put_u64(buf, map_hash());
+        put_varint(buf, seed);
+        put_varint(buf, players.size());
+        put_varint(buf, (uint64_t)bridge_capacity);
+        put_varint(buf, (uint64_t)bridge_order);
+        put_varint(buf, (uint64_t)convoy_batch);
+        put_varint(buf, (uint64_t)bridge_ticket_ttl_ms);
+        last_us = now_ns() / 1000;
+        moves = 0;
+    }
+    /* Executa e anota um movimento de p (p.direction já definido) */
+    bool run(Player &p) {
+        lock_guard<mutex> g(m);
+        uint64_t us = max(now_ns() / 1000, last_us); // Dentro do lock: instantes em ordem
+        move_clock_fixed = true;
+        move_clock_ns = us * 1000;                    // O relógio das senhas fica exatamente o gravado
+        bool moved = move_player(p);
+        move_clock_fixed = false;
+        size_t idx = find(players.begin(), players.end(), &p) - players.begin();
+        put_varint(buf, 1 + idx * 4 + (uint64_t)dir_code(p.direction));
+        put_varint(buf, us - last_us);
+        last_us = us;
+        moves += moved;
+        return moved;
+    }
+    /* Fecha a partida com o estado final e grava o arquivo */
+    bool finish(const string &path) {
+        put_varint(buf, 0);
+        put_varint(buf, moves);
+        for (Player *p : players) {
+            put_varint(buf, (uint64_t)p->x);
+            put_varint(buf, (uint64_t)p->y);
+        }
+        put_u64(buf, view_hash());
+        put_varint(buf, winner_msg.size());
+        buf.insert(buf.end(), winner_msg.begin(), winner_msg.end());
+        FILE *f = fopen(path.c_str(), "wb");
+        bool ok = f && fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+        if (f) ok = fclose(f) == 0 && ok;
+        return ok;
+    }
+};
+ReplayRecorder *recorder = nullptr;
+
+/* Consome um comando pendente do jogador e tenta executá-lo.
+ * Retorna false se não havia comando; 'moved' indica se o jogador mudou de posição. */
+bool step_player(Player &p, bool &moved) {
+    moved = false;
+    if (p.bot && p.input.empty()) p.input.push({p.bot->decide(p.x, p.y), now_ns()}); // Bot alimenta a própria fila. No modo headless, simula o teclado.
+    Command cmd;
+    if (!p.input.pop(cmd, coalesce_policy)) return false; // Retira o próximo comando da fila. No jogo, nenhuma tecla é perdida.
+
+    p.direction = cmd.dir;
+    uint64_t t0 = p.move_lat ? now_ns() : 0;
+    STAT_TIMER(s_move, H_MOVE);
+    if (recorder) moved = recorder->run(p); // Gravando: movimento serializado e anotado no replay.
+    else moved = move_player(p); // Chama função lógica para tentar mover. No jogo, executa as regras de movimento.
+    STAT_ELAPSED(H_MOVE, s_move);
+    uint64_t t1 = (p.move_lat || p.input_lat) ? now_ns() : 0;
+    if (p.move_lat) p.move_lat->record(t1 - t0); // Registra latência do movimento (inclui espera pelo mutex).
+    if (moved && p.input_lat) p.input_lat->record(t1 - cmd.t_ns); // Latência da tecla até a escrita em map_view.
+    if (moved && p.bot) p.bot->moved();
+    p.direction = ' '; // Reseta direção para consumir input. No jogo, aguarda nova tecla.
+    p.attempts++; // Conta a tentativa de movimento (tick).
+    p.moved += moved;
+    p.seen.store(pack_pos(p.x, p.y), memory_order_relaxed); // Publica o resultado do passo para o produtor da fila
+    p.steps.store(p.steps.load(memory_order_relaxed) + 1, memory_order_release);
+    if (max_ticks && ticks.fetch_add(1, memory_order_relaxed) + 1 >= max_ticks) playing = false; // Limite de ticks atingido: partida empatada.
+    return true;
+}
+
+// FUNÇÃO DA THREAD
+/* Loop de execução de cada jogador */
+void thread_player(Player &p) {
+    while (playing) { // Verifica flag global para manter thread. No jogo, define a vida útil do jogador.
+        bool moved;
+        if (step_player(p, moved)) { // Checa input e executa o movimento. No jogo, evita processamento inútil se parado.
+            if (move_delay_ms) this_thread::sleep_for(chrono::milliseconds(move_delay_ms)); // Executa sleep para controlar velocidade. No jogo, define o ritmo/dificuldade.
+        } else {
+            p.idle_polls++;
+            this_thread::sleep_for(chrono::milliseconds(idle_delay_ms)); // Executa sleep curto para evitar CPU 100%. No jogo, economiza recursos enquanto ocioso.
+        }
+    }
+}
+
+#ifndef HEADLESS
+/* Traduz uma tecla em comando na fila do jogador correspondente */
+void handle_key(int ch, InputQueue &in1, InputQueue &in2) {
+    uint64_t t_key = now_ns(); // Carimbo de tempo da leitura, para medir latência até o movimento.
+    switch(ch) {
+        case 'w': in1.push({'u', t_key}); break; // Enfileira comando para P1. No jogo, P1 vai para cima.
+        case 's': in1.push({'d', t_key}); break; // Enfileira comando para P1. No jogo, P1 vai para baixo.
+        case 'a': in1.push({'l', t_key}); break; // Enfileira comando para P1. No jogo, P1 vai para esquerda.
+        case 'd': in1.push({'r', t_key}); break; // Enfileira comando para P1. No jogo, P1 vai para direita.
+
+        case KEY_UP:    in2.push({'u', t_key}); break; // Enfileira comando para P2. No jogo, P2 vai para cima.
+        case KEY_DOWN:  in2.push({'d', t_key}); break; // Enfileira comando para P2. No jogo, P2 vai para baixo.
+        case KEY_LEFT:  in2.push({'l', t_key}); break; // Enfileira comando para P2. No jogo, P2 vai para esquerda.
+        case KEY_RIGHT: in2.push({'r', t_key}); break; // Enfileira comando para P2. No jogo, P2 vai para direita.
+
+        case 'i': toggle_stats_overlay(); break; // Liga/desliga o painel de instrumentação. No jogo, mostra disputa e latências.
+        case 'q': playing = false; break; // Altera flag para encerrar. No jogo, sai do programa.
+    }
+}
+#endif // HEADLESS
+
+// --- MODO EVENTOS (epoll + timerfd) ---
+// Alternativa às threads com sleep_for: uma única thread multiplexa a entrada (stdin) e dois
+// temporizadores. A simulação avança em ticks fixos e determinísticos (todos os jogadores, sempre
+// na mesma ordem) e o desenho tem ritmo próprio, limitado a render_fps e só quando algo mudou.
+// Sem comandos pendentes, os temporizadores ficam desarmados e a thread dorme em epoll_wait.
+
+struct EventLoopConfig {
+    long tick_us = 100000;  // Período da simulação (igual à pausa de movimento do modo com threads)
+    int render_fps = 30;    // Limite de quadros por segundo (0 = não desenha)
+    bool read_stdin = true; // Lê o teclado (desligado no modo headless)
+    int input_fd = -1;      // Teclado simulado (benchmark): pares de bytes (jogador, direção); EOF encerra a partida
+};
+
+struct EventLoopStats {
+    uint64_t wakeups = 0;      // Retornos de epoll_wait
+    uint64_t idle_wakeups = 0; // Acordadas sem trabalho útil (nem tick, nem desenho, nem tecla)
+    uint64_t sim_ticks = 0;    // Ticks de simulação executados
+    uint64_t missed_ticks = 0; // Ticks pulados por atraso maior que um período
+    uint64_t frames = 0;       // Quadros desenhados
+    Histogram jitter;          // Atraso (ns) entre o instante programado do tick e o acordar
+};
+
+/* Programa um temporizador one-shot para o instante absoluto 'deadline_ns' (0 = desarma) */
+static void arm_timer(int fd, uint64_t deadline_ns) {
+    itimerspec its = {};
+    its.it_value.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+    its.it_value.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, nullptr);
+}
+
+/* Avança um tick: cada jogador consome no máximo um comando. Retorna true se alguém se moveu. */
+bool simulate_tick(Player **players, int n) {
+    bool any_moved = false;
+    for (int i = 0; i < n && playing; i++) {
+        bool moved;
+        step_player(*players[i], moved);
+        any_moved |= moved;
+    }
+    return any_moved;
+}
+
+/* Há trabalho para o próximo tick? (comandos pendentes ou bots, que sempre decidem) */
+static bool has_pending(Player **players, int n) {
+    for (int i = 0; i < n; i++)
+        if (players[i]->bot || !players[i]->input.empty()) return true;
+    return false;
+}
+
+/* Loop orientado a eventos: roda até 'playing' virar false.
+ * Retorna false (com a causa em 'err') se o epoll ou os temporizadores não puderem ser criados. */
+bool run_event_loop(Player **players, int n, const EventLoopConfig &cfg, EventLoopStats &st, string &err) {
+    int ep = epoll_create1(0);
+    int tick_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK); // steady_clock usa CLOCK_MONOTONIC
+    int frame_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    const char *failed = ep < 0 ? "epoll_create1" : (tick_fd < 0 || frame_fd < 0) ? "timerfd_create" : nullptr;
+    if (!failed) {
+        ev.data.fd = tick_fd;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, tick_fd, &ev) < 0) failed = "epoll_ctl";
+        ev.data.fd = frame_fd;
+        if (!failed && epoll_ctl(ep, EPOLL_CTL_ADD, frame_fd, &ev) < 0) failed = "epoll_ctl";
+        ev.data.fd = STDIN_FILENO;
+        if (!failed && cfg.read_stdin && epoll_ctl(ep, EPOLL_CTL_ADD, STDIN_FILENO, &ev) < 0) failed = "epoll_ctl";
+        ev.data.fd = cfg.input_fd;
+        if (!failed && cfg.input_fd >= 0 && epoll_ctl(ep, EPOLL_CTL_ADD, cfg.input_fd, &ev) < 0) failed = "epoll_ctl";
+    }
+    if (failed) { // Sem o loop não há partida: fecha o que abriu e deixa o chamador reportar
+        err = string(failed) + ": " + strerror(errno);
+        if (frame_fd >= 0) close(frame_fd);
+        if (tick_fd >= 0) close(tick_fd);
+        if (ep >= 0) close(ep);
+        return false;
+    }
+
+    const uint64_t period = (uint64_t)cfg.tick_us * 1000;
+    const uint64_t frame_period = cfg.render_fps > 0 ? 1000000000ULL / cfg.render_fps : 0;
+    uint64_t next_tick = 0;   // Instante do próximo tick (0 = temporizador desarmado)
+    uint64_t last_frame = 0;  // Instante do último quadro desenhado
+    bool frame_armed = false;
+    bool dirty = frame_period != 0; // Primeiro quadro sempre é desenhado
+
+    while (playing) {
+        /* Arma o tick só quando há o que simular; ocioso, a thread dorme indefinidamente */
+        if (!next_tick && has_pending(players, n)) {
+            next_tick = now_ns() + period;
+            arm_timer(tick_fd, next_tick);
+        }
+        if (dirty && !frame_armed && frame_period) {
+            arm_timer(frame_fd, max(last_frame + frame_period, now_ns() + 1));
+            frame_armed = true;
+        }
+
+        epoll_event events[4];
+        int ready = epoll_wait(ep, events, 4, -1);
+        if (ready < 0) continue; // EINTR (ex.: redimensionamento do terminal)
+        st.wakeups++;
+        bool useful = false;
+
+        for (int e = 0; e < ready; e++) {
+            int fd = events[e].data.fd;
+            if (fd == tick_fd) {
+                uint64_t expirations;
+                if (read(tick_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+                uint64_t now = now_ns();
+                st.jitter.record(now - next_tick);
+                if (simulate_tick(players, n)) dirty = true;
+                st.sim_ticks++;
+                useful = true;
+                next_tick += period;
+                if (next_tick <= now) { // Atraso maior que um período: pula ticks em vez de acumular
+                    uint64_t behind = (now - next_tick) / period + 1;
+                    st.missed_ticks += behind;
+                    next_tick += behind * period;
+                }
+                if (has_pending(players, n)) arm_timer(tick_fd, next_tick);
+                else next_tick = 0; // Nada pendente: desarma até a próxima tecla
+            } else if (fd == frame_fd) {
+                uint64_t expirations;
+                if (read(frame_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+                frame_armed = false;
+                if (dirty) {
+                    draw_map();
+                    st.frames++;
+                    last_frame = now_ns();
+                    dirty = false;
+                    useful = true;
+                }
+            }
+            else if (fd == cfg.input_fd) {
+                char buf[64]; // Cada escrita tem 2 bytes (atômica no pipe): a leitura nunca parte um par
+                ssize_t k = read(fd, buf, sizeof buf);
+                if (k <= 0) playing = false; // Teclado fechado: fim da partida
+                for (ssize_t j = 0; j + 1 < k; j += 2)
+                    if (buf[j] >= 0 && buf[j] < n) players[(int)buf[j]]->input.push({buf[j + 1], now_ns()});
+                useful = true;
+            }
+#ifndef HEADLESS
+            else if (fd == STDIN_FILENO) {
+                int ch;
+                while ((ch = getch()) != ERR) handle_key(ch, players[0]->input, players[1]->input);
+                useful = true;
+            }
+#endif
+        }
+        if (!useful) st.idle_wakeups++;
+    }
+    if (frame_period) draw_map(); // Quadro final
+
+    close(frame_fd);
+    close(tick_fd);
+    close(ep);
+    return true;
+}
+
+
+/* Prepara o mapa de uma nova partida: cenário limpo, semáforo da ponte livre, nenhum vencedor */
+void reset_map() {
+    /* Inicializa o mapa visual com a base estática */
+    if (!grid.text) use_default_map(); // Nenhum --map: usa o mapa embutido
+    reset_view();
+
+    /* Inicialização dos Semáforos POSIX (um por ponte) */
+    if (bridges.empty()) setup_bridges(); // Identifica as pontes do mapa na primeira partida
+    for (auto &b : bridges) b->reset(bridge_capacity); // Ponte vazia, semáforo com todas as vagas
+    setup_regions(); // Mutexes das regiões do mapa, com contadores zerados
+
+    playing = true;
+    winner_msg = "";
+    ticks = 0;
+    invalidate_frame(); // Primeiro quadro da partida redesenha a tela inteira
+}
+
+/* Coloca um jogador na largada (x, y), sem comandos pendentes */
+void place_player(Player &p, int x, int y) {
+    p.x = x;
+    p.y = y;
+    p.direction = ' ';
+    p.attempts = 0;
+    p.moved = 0;
+    p.idle_polls = 0;
+    p.bridge_ticket = -1;
+    p.seen.store(pack_pos(x, y), memory_order_relaxed);
+    p.steps.store(0, memory_order_relaxed); // A thread do jogador só nasce depois: a criação publica os dois
+    p.input.clear(); // Descarta comandos da partida anterior
+    occupy_cell(occupants_at(x, y), view_at(x, y), p.symbol); // Escreve na matriz para mostrar o jogador na largada.
+}
+
+/* Prepara uma nova partida de dois jogadores */
+void reset_match(Player &p1, Player &p2) {
+    reset_map();
+    place_player(p1, grid.start1_x, grid.start1_y); // Posição inicial esquerda (no mapa padrão, 1,1).
+    place_player(p2, grid.start2_x, grid.start2_y); // Posição inicial direita (no mapa padrão, 19,58).
+}
+
+// --- REPLAY (REPRODUÇÃO) ---
+
+/* Resultado da reprodução de um replay */
+struct ReplayResult {
+    uint64_t events = 0; // Comandos reaplicados
+    uint64_t moves = 0;  // Dos quais mudaram a posição do jogador
+    string err;          // Primeira divergência encontrada (vazio = estado final idêntico)
+};
+
+/* Reexecuta um replay (já lido em memória) na velocidade máxima, sem desenho nem threads, e
+ * confere o estado final com o rodapé gravado. O mapa carregado precisa ser o da gravação; a
+ * configuração das pontes vem do cabeçalho. */
+bool play_replay(const vector<uint8_t> &data, ReplayResult &res) {
+    const uint8_t *in = data.data(), *end = in + data.size();
+    auto fail = [&res](const string &why) { res.err = why; return false; };
+    res = ReplayResult();
+    if (data.size() < 4 || memcmp(in, "RSR1", 4) != 0) return fail("formato desconhecido");
+    in += 4;
+    uint64_t hash, seed, n, cap, order, convoy, ttl;
+    if (!get_u64(in, end, hash) || !get_varint(in, end, seed) || !get_varint(in, end, n) || !get_varint(in, end, cap) ||
+        !get_varint(in, end, order) || !get_varint(in, end, convoy) || !get_varint(in, end, ttl))
+        return fail("cabecalho truncado");
+    if (hash != map_hash()) return fail("mapa diferente do gravado");
+    if (n != 2 || cap == 0 || cap > INT_MAX || order > ORDER_FIFO || convoy > INT_MAX || ttl > INT_MAX)
+        return fail("cabecalho invalido");
+    bridge_capacity = (int)cap;
+    bridge_order = (BridgeOrder)order;
+    convoy_batch = (int)convoy;
+    bridge_ticket_ttl_ms = (int)ttl;
+
+    Player p1 = {0, 0, '1', ' '};
+    Player p2 = {0, 0, '2', ' '};
+    Player *players[2] = {&p1, &p2};
+    reset_match(p1, p2);
+    uint64_t clock_us = 0;
+    for (;;) {
+        uint64_t key, delta;
+        if (!get_varint(in, end, key)) return fail("eventos truncados");
+        if (key == 0) break;
+        if (!get_varint(in, end, delta) || key - 1 >= n * 4) return fail("evento invalido");
+        Player &p = *players[(key - 1) / 4];
+        clock_us += delta;
+        move_clock_fixed = true;
+        move_clock_ns = clock_us * 1000; // Mesmo relógio de senhas da gravação
+        p.direction = "udlr"[(key - 1) % 4];
+        res.moves += move_player(p);
+        move_clock_fixed = false;
+        p.direction = ' ';
+        res.events++;
+    }
+
+    uint64_t moves, vhash, len;
+    if (!get_varint(in, end, moves)) return fail("rodape truncado");
+    if (moves != res.moves)
+        return fail("movimentos: gravados " + to_string(moves) + ", reproduzidos " + to_string(res.moves));
+    for (Player *p : players) {
+        uint64_t x, y;
+        if (!get_varint(in, end, x) || !get_varint(in, end, y)) return fail("rodape truncado");
+        if (x != (uint64_t)p->x || y != (uint64_t)p->y)
+            return fail(string("posicao final do jogador ") + p->symbol + ": gravada " + to_string(x) + "," + to_string(y) +
+                        ", reproduzida " + to_string(p->x) + "," + to_string(p->y));
+    }
+    if (!get_u64(in, end, vhash) || !get_varint(in, end, len) || (uint64_t)(end - in) != len) return fail("rodape truncado");
+    if (vhash != view_hash()) return fail("map_view final diferente");
+    string winner((const char *)in, (size_t)len);
+    if (winner != winner_msg) return fail("winner_msg: gravado '" + winner + "', reproduzido '" + winner_msg + "'");
+    return true;
+}
+
+/* Lê um arquivo inteiro para a memória */
+bool read_file(const string &path, vector<uint8_t> &data) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    data.clear();
+    uint8_t chunk[1 << 16];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + got);
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+/* Converte o nome da política de agrupamento ("none", "latest", "repeat") */
+bool parse_coalesce(const string &name, Coalesce &out) {
+    if (name == "none") out = COALESCE_NONE;
+    else if (name == "latest") out = COALESCE_LATEST;
+    else if (name == "repeat") out = COALESCE_REPEAT;
+    else return false;
+    return true;
+}
+
+// --- MODO N JOGADORES (POOL COM ROUBO DE TRABALHO) ---
+// Com centenas ou milhares de bots não dá para ter uma thread do SO por jogador. Cada jogador
+// vira uma tarefa ("dar um passo"); um número fixo de workers (um por núcleo) executa as
+// tarefas e as recoloca na própria fila enquanto a partida continua. Um worker sem tarefas
+// rouba do fim da fila de outro, equilibrando a carga.
+
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int workers) : queues(workers) {}
+
+    /* Distribui as tarefas iniciais em rodízio e executa até 'playing' virar false.
+     * step(tarefa) devolve true se a tarefa deve voltar para a fila. */
+    template <class Step>
+    void run(const vector<int> &tasks, Step step) {
+        for (size_t i = 0; i < tasks.size(); i++) queues[i % queues.size()].q.push_back(tasks[i]);
+        vector<thread> workers;
+        for (size_t w = 0; w < queues.size(); w++) {
+            workers.emplace_back([this, w, &step] {
+                LockStats lock_begin = LockStats::of(stats_local()); // Só o que este worker contar daqui em diante
+                uint64_t my_steals = 0;
+                int task;
+                while (playing) {
+                    if (!pop_own((int)w, task)) {
+                        if (!steal((int)w, task)) { this_thread::yield(); continue; } // Tarefas em execução nos outros workers
+                        my_steals++;
+                    }
+                    if (step(task)) queues[w].push(task);
+                }
+                lock_guard<mutex> g(totals_mtx); // Soma os contadores deste worker no total do pool
+                lock_totals.add_delta(LockStats::of(stats_local()), lock_begin);
+                steals += my_steals;
+            });
+        }
+        for (thread &t : workers) t.join();
+        for (WorkerQueue &wq : queues) wq.q.clear();
+    }
+
+    int size() const { return (int)queues.size(); }
+
+    LockStats lock_totals; // Disputa pelos mutexes do mapa somada de todos os workers
+    uint64_t steals = 0;   // Tarefas roubadas de outro worker
+
+private:
+    struct alignas(64) WorkerQueue { // Alinhada à linha de cache: filas vizinhas não disputam a mesma linha
+        mutex m;
+        deque<int> q;
+        void push(int t) { lock_guard<mutex> g(m); q.push_back(t); }
+    };
+
+    bool pop_own(int w, int &task) { // O dono consome do início (FIFO: rodízio justo entre seus jogadores)
+        WorkerQueue &wq = queues[w];
+        lock_guard<mutex> g(wq.m);
+        if (wq.q.empty()) return false;
+        task = wq.q.front();
+        wq.q.pop_front();
+        return true;
+    }
+    bool steal(int w, int &task) { // Ladrões levam do fim, longe do dono
+        int n = (int)queues.size();
+        for (int k = 1; k < n; k++) {
+            WorkerQueue &victim = queues[(w + k) % n];
+            lock_guard<mutex> g(victim.m);
+            if (victim.q.empty()) continue;
+            task = victim.q.back();
+            victim.q.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    vector<WorkerQueue> queues;
+    mutex totals_mtx;
+};
+
+/* Cria n bots em posições aleatórias do próprio lado (pares = time '1' em cima, ímpares = time '2' embaixo).
+ * O mapa já deve ter sido preparado por reset_map(). Sorteia entre as células de chão (nunca parede nem
+ * ponte) de cada metade; retorna false, sem criar ninguém, se alguma metade não tiver chão. */
+bool spawn_bots(vector<unique_ptr<Player>> &players, vector<unique_ptr<Bot>> &bots, int n, uint64_t seed) {
+    players.clear();
+    bots.clear();
+    vector<pair<int, int>> floor[2]; // Candidatas de cada time (linhas acima / abaixo do meio)
+    int half = grid.rows / 2;
+    for (int x = 0; x < grid.rows; x++) {
+        if (x == half) continue; // A linha do meio não é de nenhum time
+        for (int y = 0; y < grid.cols; y++)
+            if (terrain_at(x, y) == T_FLOOR) floor[x > half].push_back({x, y});
+    }
+    if (n > 0 && (floor[0].empty() || (n > 1 && floor[1].empty()))) return false;
+    Bot placer;
+    placer.rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    for (int i = 0; i < n; i++) {
+        bool top = i % 2 == 0;
+        const auto &cells = floor[!top];
+        auto [x, y] = cells[placer.next_random() % cells.size()];
+        bots.emplace_back(new Bot());
+        bots.back()->rng = placer.next_random() | 1ULL;
+        players.emplace_back(new Player{x, y, top ? '1' : '2', ' '});
+        players.back()->bot = bots.back().get();
+        place_player(*players.back(), x, y);
+    }
+    return true;
+}
+
+/* Executa uma partida de N bots no pool até alguém vencer ou 'playing' ser desligado de fora */
+void run_pool_match(vector<unique_ptr<Player>> &players, WorkStealingPool &pool) {
+    vector<int> tasks(players.size());
+    for (size_t i = 0; i < players.size(); i++) tasks[i] = (int)i;
+    pool.run(tasks, [&players](int i) {
+        bool moved;
+        step_player(*players[i], moved); // Um passo do jogador i; depois volta para a fila
+        return true;
+    });
+}
+
+// --- PARTIDA COMO INSTÂNCIA (Match) ---
+// O jogo clássico guarda a partida em globais (map_view, map_locks, bridges, playing, winner_msg):
+// uma partida por processo. Match reúne o estado mutável de uma partida num único bloco contíguo
+// (cabeçalho, jogadores, um mutex por região, um semáforo por ponte e o mapa visual), sem ponteiros
+// internos: o mesmo bloco serve num segmento compartilhado entre processos (modo --procs) ou numa
+// arena reaproveitada partida após partida (torneio). O que é do mapa e não muda (grade, bitboards,
+// tabela de pontes, tamanho das regiões) continua global e só leitura.
+
+/* Jogador de uma Match. x, y e symbol só mudam pelo próprio jogador, sob o mutex da região. */
+struct alignas(64) MatchPlayer {
+    int x, y;
+    int dest_x, dest_y; // Destino do último passo, anotado antes de ocupar a célula nova (para match_reap)
+    char symbol;
+    atomic<int> bridge{-1};      // Ponte ocupada (-1 = nenhuma): o supervisor devolve a vaga se o processo morrer
+    atomic<int> alive{1};
+    atomic<uint64_t> attempts{0}; // Tentativas de movimento (escritor único: o processo do jogador)
+    atomic<uint64_t> moved{0};    // Tentativas que de fato moveram (idem)
+    atomic<uint64_t> contended{0}; // Travas de região que encontraram o mutex ocupado (idem)
+    InputQueue input;             // Comandos do teclado (processo renderizador -> processo do jogador)
+    pid_t pid = 0;
+};
+struct alignas(64) MatchRegion {
+    pthread_mutex_t m;
+    atomic<uint32_t> seq{0}; // Seqlock da região, como em RegionLock (o renderizador não trava m)
+};
+struct alignas(64) MatchBridge { sem_t sem; };
+
+/* Largada de um jogador */
+struct MatchStart {
+    int x, y;
+    char symbol;
+};
+
+/* Deslocamentos das tabelas dentro do bloco (alinhados a 64 bytes) */
+struct MatchLayout {
+    int nplayers = 0;
+    size_t players_off = 0, regions_off = 0, bridges_off = 0, view_off = 0, occ_off = 0;
+    size_t bytes = 0; // Tamanho total do bloco
+};
+
+/* Cabeçalho do bloco; as tabelas seguem nos deslocamentos do layout */
+struct Match {
+    size_t bytes = 0;
+    int nplayers = 0, nregions = 0, nbridges = 0;
+    bool process_shared = false;
+    atomic<int> playing{1};
+    atomic<int> winner{-1};          // Índice do jogador que chegou à bandeira (-1 = ninguém)
+    atomic<uint64_t> recovered{0};   // Mutexes herdados de processos mortos (EOWNERDEAD)
+    atomic<uint64_t> frames{0};      // Quadros copiados pelo renderizador
+    atomic<uint64_t> locked_frames{0}; // Desses, os copiados com os mutexes (seqlock desistiu)
+    size_t players_off = 0, regions_off = 0, bridges_off = 0, view_off = 0, occ_off = 0;
+
+    MatchPlayer *players() { return (MatchPlayer *)((char *)this + players_off); }
+    MatchRegion *regions() { return (MatchRegion *)((char *)this + regions_off); }
+    MatchBridge *bridges() { return (MatchBridge *)((char *)this + bridges_off); }
+    char &view(int x, int y) { return ((char *)this + view_off)[(size_t)x * grid.cols + y]; } // Sem padding de linha
+    /* Jogadores de cada time na célula, como cell_occupants (um byte por time: MATCH_MAX_TEAM por célula) */
+    uint8_t *occupants(int x, int y) { return (uint8_t *)((char *)this + occ_off) + ((size_t)x * grid.cols + y) * 2; }
+};
+const int MATCH_MAX_TEAM = 255; // Jogadores por time numa Match (contadores de ocupação de um byte)
+
+/* Layout de uma partida de n jogadores no mapa atual (pontes e regiões já preparadas por reset_map) */
+MatchLayout match_layout(int nplayers) {
+    auto align = [](size_t v) { return (v + 63) & ~(size_t)63; };
+    MatchLayout l;
+    l.nplayers = nplayers;
+    l.players_off = align(sizeof(Match));
+    l.regions_off = align(l.players_off + (size_t)nplayers * sizeof(MatchPlayer));
+    l.bridges_off = align(l.regions_off + (size_t)tiles_y * tiles_x * sizeof(MatchRegion));
+    l.view_off = align(l.bridges_off + bridges.size() * sizeof(MatchBridge));
+    l.occ_off = l.view_off + (size_t)grid.rows * grid.cols;
+    l.bytes = align(l.occ_off + (size_t)grid.rows * grid.cols * 2);
+    return l;
+}
+
+/* Constrói uma partida em 'mem' (l.bytes, alinhado a 64): cenário limpo e jogadores na largada.
+ * process_shared: mutexes PTHREAD_PROCESS_SHARED + ROBUST e semáforos pshared (modo --procs);
+ * senão, mutexes comuns, mais baratos. Não aloca nada. */
+Match *match_init(void *mem, const MatchLayout &l, const MatchStart *starts, bool process_shared) {
+    Match *m = new (mem) Match();
+    m->bytes = l.bytes;
+    m->nplayers = l.nplayers;
+    m->nregions = tiles_y * tiles_x;
+    m->nbridges = (int)bridges.size();
+    m->process_shared = process_shared;
+    m->players_off = l.players_off;
+    m->regions_off = l.regions_off;
+    m->bridges_off = l.bridges_off;
+    m->view_off = l.view_off;
+    m->occ_off = l.occ_off;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    if (process_shared) {
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED); // Visível a todos os processos que mapeiam o segmento
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);     // Dono morto não deixa o mutex travado para sempre
+    }
+    for (int r = 0; r < m->nregions; r++) pthread_mutex_init(&(new (&m->regions()[r]) MatchRegion())->m, &attr);
+    pthread_mutexattr_destroy(&attr);
+    for (int b = 0; b < m->nbridges; b++)
+        sem_init(&m->bridges()[b].sem, process_shared, (unsigned)bridge_capacity); // pshared = 1: semáforo entre processos
+    for (int i = 0; i < grid.rows; i++) memcpy(&m->view(i, 0), grid.text + (size_t)i * grid.stride, grid.cols);
+    memset(m->occupants(0, 0), 0, (size_t)grid.rows * grid.cols * 2);
+    for (int i = 0; i < m->nplayers; i++) {
+        MatchPlayer *p = new (&m->players()[i]) MatchPlayer();
+        p->x = starts[i].x;
+        p->y = starts[i].y;
+        p->dest_x = p->x;
+        p->dest_y = p->y;
+        p->symbol = starts[i].symbol;
+        occupy_cell(m->occupants(p->x, p->y), m->view(p->x, p->y), p->symbol);
+    }
+    return m;
+}
+
+/* Destrói mutexes e semáforos; a memória continua com o dono (arena ou segmento) */
+void match_destroy(Match *m) {
+    for (int r = 0; r < m->nregions; r++) pthread_mutex_destroy(&m->regions()[r].m);
+    for (int b = 0; b < m->nbridges; b++) sem_destroy(&m->bridges()[b].sem);
+}
+
+// --- MODO MULTIPROCESSO (MEMÓRIA COMPARTILHADA) ---
+// Cada jogador roda num processo próprio (fork) e a Match vive num segmento mmap(MAP_SHARED)
+// criado antes do fork, com mutexes PTHREAD_PROCESS_SHARED + PTHREAD_MUTEX_ROBUST e semáforos
+// sem_init(&sem, 1, capacidade). A grade, os bitboards e a tabela de pontes são só leitura e
+// chegam aos filhos pelo próprio fork. O renderizador lê o segmento direto, sem cópia por pipe.
+// Um processo que morre com uma região travada não trava a partida: o próximo a travar recebe
+// EOWNERDEAD e marca o mutex consistente; o supervisor (pai) apaga o jogador morto do mapa e
+// devolve a vaga da ponte que ele ocupava. A admissão nas pontes é a do sem_trywait (sem fila de
+// senhas nem comboios: BridgeController guarda ponteiros e deque, que não atravessam processos).
+
+/* Cria a partida num segmento compartilhado, com os jogadores nas posições de 'players' */
+Match *shm_create(const vector<Player *> &players) {
+    MatchLayout l = match_layout((int)players.size());
+    void *mem = mmap(nullptr, l.bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+    vector<MatchStart> starts;
+    for (Player *p : players) starts.push_back({p->x, p->y, p->symbol});
+    return match_init(mem, l, starts.data(), true);
+}
+
+void shm_destroy(Match *sm) {
+    match_destroy(sm);
+    munmap(sm, sm->bytes);
+}
+
+/* Trava uma região; se o dono anterior morreu com ela travada, assume e marca o mutex consistente.
+ * 'contended', se dado, é o contador de disputas do jogador que trava (escritor único). */
+static void match_lock(Match &sm, int r, atomic<uint64_t> *contended = nullptr) {
+    pthread_mutex_t *m = &sm.regions()[r].m;
+    int rc = pthread_mutex_trylock(m); // Caso comum: região livre
+    if (rc == EBUSY) {
+        if (contended) contended->store(contended->load(memory_order_relaxed) + 1, memory_order_relaxed);
+        rc = pthread_mutex_lock(m);
+    }
+    if (rc == EOWNERDEAD) {
+        pthread_mutex_consistent(m); // A célula do morto é limpa pelo supervisor (match_reap)
+        atomic<uint32_t> &seq = sm.regions()[r].seq;
+        if (seq.load() & 1) seq_write_end(seq); // Morreu no meio da escrita: fecha a seção para os leitores
+        sm.recovered.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+static inline void match_unlock(Match &sm, int r) {
+    pthread_mutex_unlock(&sm.regions()[r].m);
+}
+
+/* Estado de uma Match para apply_move. A admissão nas pontes é só o sem_trywait (sem senhas nem
+ * comboios); a vaga fica anotada em p.bridge para o supervisor devolvê-la se o processo morrer. */
+struct MatchWorld {
+    Match &sm;
+    MatchPlayer &p;
+    int i;
+    void lock(int r) { match_lock(sm, r, &p.contended); }
+    void unlock(int r) { match_unlock(sm, r); }
+    atomic<uint32_t> &seq(int r) { return sm.regions()[r].seq; }
+    char &view(int x, int y) { return sm.view(x, y); }
+    uint8_t *occupants(int x, int y) { return sm.occupants(x, y); }
+    bool enter_bridge(int b, char) {
+        if (sem_trywait(&sm.bridges()[b].sem) != 0) return false; // Ponte cheia: tenta no próximo ciclo
+        p.bridge.store(b, memory_order_relaxed); // Logo após pegar a vaga: se morrer daqui em diante, o supervisor a devolve
+        return true;
+    }
+    void off_bridge() {}
+    void leave_bridge(int b) {
+        /* Primeiro esquece a vaga, depois a devolve: morrer entre os dois perde uma vaga, mas nunca
+         * admite um jogador a mais na ponte (a ordem inversa poderia devolvê-la duas vezes) */
+        p.bridge.store(-1, memory_order_relaxed);
+        sem_post(&sm.bridges()[b].sem);
+    }
+    void win() {
+        int none = -1;
+        sm.winner.compare_exchange_strong(none, i); // Primeiro a chegar vence
+        if (end_on_win) sm.playing.store(0);
+    }
+    bool crash_mid_step = false; // Teste de recuperação: morre com o passo pela metade
+    void stepping(int nx, int ny) {
+        p.dest_x = nx; // O processo pode morrer até occupy_cell: o supervisor refaz as duas células
+        p.dest_y = ny;
+        if (crash_mid_step) raise(SIGKILL);
+    }
+};
+
+/* move_player sobre uma Match: mesmas regras e mesma ordem de travamento (apply_move). Com
+ * crash_mid_step, o processo morre no meio do passo (regiões travadas, seqlock ímpar, célula antiga
+ * já liberada e a nova não ocupada). */
+bool match_move(Match &sm, int i, char dir, bool crash_mid_step = false) {
+    MatchWorld w{sm, sm.players()[i], i};
+    w.crash_mid_step = crash_mid_step;
+    return apply_move(w, w.p, dir);
+}
 
-/* Função responsável por desenhar o estado atual do jogo na tela */
-void draw_map() {
-    /* Início da Seção Crítica de Leitura: Bloqueia acesso simultâneo ao mapa */
-    unique_lock<mutex> lock(mtx_map); // Adquire lock do mutex para bloquear escrita no mapa. No jogo, garante desenho consistente sem falhas.
-    
-    for (int i = 0; i < LIN; i++) {
-        for (int j = 0; j < COL; j++) {
-            char cell = map_view[i][j];
-            
-            if (cell == '1') attron(COLOR_PAIR(1));      // Ativa cor P1 para preparar texto. No jogo, visualização do Jogador 1.
-            else if (cell == '2') attron(COLOR_PAIR(2)); // Ativa cor P2 para preparar texto. No jogo, visualização do Jogador 2.
-            else if (cell == '#') attron(COLOR_PAIR(3)); // Ativa cor parede para preparar texto. No jogo, visualização de obstáculo.
-            else if (cell == 'C') attron(COLOR_PAIR(4)); // Ativa cor ponte para preparar texto. No jogo, visualização da Região Crítica.
-            else if (cell == 'F') attron(COLOR_PAIR(5)); // Ativa cor fim para preparar texto. No jogo, visualização do objetivo.
-            
-            mvaddch(i, j, cell); // Imprime caractere na posição para atualizar buffer. No jogo, constrói o quadro atual.
-            
-            attroff(COLOR_PAIR(1)); // Desativa cor para limpar atributo. No jogo, evita contaminação de cores.
-            attroff(COLOR_PAIR(2)); // Desativa cor para limpar atributo. No jogo, evita contaminação de cores.
-            attroff(COLOR_PAIR(3)); // Desativa cor para limpar atributo. No jogo, evita contaminação de cores.
-            attroff(COLOR_PAIR(4)); // Desativa cor para limpar atributo. No jogo, evita contaminação de cores.
-            attroff(COLOR_PAIR(5)); // Desativa cor para limpar atributo. No jogo, evita contaminação de cores.
-        }
-    }
-    refresh(); // Atualiza tela real para transferir buffer. No jogo, o usuário vê o quadro desenhado.
-    /* O destrutor do unique_lock libera o mutex automaticamente aqui (RAII) */
+/* Refaz a contagem de ocupantes da célula (x, y) a partir das posições dos jogadores vivos, com a
+ * região da célula travada: nenhum vivo entra nem sai dela enquanto isso. */
+static void match_recount(Match &sm, int x, int y) {
+    uint8_t *occ = sm.occupants(x, y);
+    occ[0] = occ[1] = 0;
+    for (int j = 0; j < sm.nplayers; j++) {
+        MatchPlayer &q = sm.players()[j];
+        if (q.alive.load(memory_order_relaxed) && __atomic_load_n(&q.x, __ATOMIC_RELAXED) == x &&
+            __atomic_load_n(&q.y, __ATOMIC_RELAXED) == y) // Vivos de outras regiões podem estar escrevendo x, y
+            occ[q.symbol == '2']++;
+    }
+    char &cell = sm.view(x, y);
+    if (!occ[0] && !occ[1]) cell = base_at(x, y);
+    else if (!occ[cell == '2'] || (cell != '1' && cell != '2')) cell = occ[0] ? '1' : '2'; // Mantém o símbolo se o time ainda está lá
 }
 
-/* Verifica se o movimento para (nx, ny) é válido */
-bool allow_move(int nx, int ny) {
-    if (nx < 0 || nx >= LIN || ny < 0 || ny >= COL) return false; // Checa limites para validar coordenadas. No jogo, impede segfault ou saída do mapa.
-    if (map_view[nx][ny] == '#') return false; // Checa parede para verificar colisão sólida. No jogo, impede atravessar obstáculos.
-    return true; // Retorna true para confirmar validade. No jogo, permite o movimento.
+/* Supervisor: o processo do jogador i morreu. Apaga o jogador do mapa e devolve a vaga da ponte.
+ * O morto pode ter parado no meio de um passo (célula antiga liberada, nova ainda não ocupada), então
+ * as duas células do passo são recontadas em vez de um vacate_cell às cegas. */
+void match_reap(Match &sm, int i) {
+    MatchPlayer &p = sm.players()[i];
+    int r_a = region_of(p.x, p.y), r_b = region_of(p.dest_x, p.dest_y);
+    int r_first = min(r_a, r_b), r_second = max(r_a, r_b);
+    match_lock(sm, r_first); // Recupera o mutex se o morto o segurava (fechando o seqlock ímpar)
+    if (r_second != r_first) match_lock(sm, r_second);
+    p.alive.store(0);
+    seq_write_begin(sm.regions()[r_first].seq);
+    if (r_second != r_first) seq_write_begin(sm.regions()[r_second].seq);
+    match_recount(sm, p.x, p.y);
+    match_recount(sm, p.dest_x, p.dest_y);
+    if (r_second != r_first) seq_write_end(sm.regions()[r_second].seq);
+    seq_write_end(sm.regions()[r_first].seq);
+    if (r_second != r_first) match_unlock(sm, r_second);
+    match_unlock(sm, r_first);
+    int b = p.bridge.exchange(-1);
+    if (b >= 0) sem_post(&sm.bridges()[b].sem);
 }
 
-/* Lógica principal de movimento, colisão e sincronização */
-void move_player(Player &p) {
-    int nx = p.x; // Cria cópia local de X para cálculo. No jogo, prepara nova posição.
-    int ny = p.y; // Cria cópia local de Y para cálculo. No jogo, prepara nova posição.
+const uint64_t MATCH_SEQ_RETRIES = 64; // Cópias otimistas por quadro antes de travar as regiões
 
-    /* Calcula a nova coordenada baseada na direção */
-    switch (p.direction) {
-        case 'u': nx--; break; // Decrementa X para mover para cima. No jogo, define destino do movimento.
-        case 'd': nx++; break; // Incrementa X para mover para baixo. No jogo, define destino do movimento.
-        case 'l': ny--; break; // Decrementa Y para mover para esquerda. No jogo, define destino do movimento.
-        case 'r': ny++; break; // Incrementa Y para mover para direita. No jogo, define destino do movimento.
-        default: return; // Caso padrão para ignorar input inválido. No jogo, não faz nada.
+/* Copia a janela frame_rows x frame_cols da partida para 'out' pelo seqlock das regiões (sem travar).
+ * Um jogador morto entre seq_write_begin e seq_write_end deixa o contador ímpar até alguém herdar o
+ * mutex; depois de MATCH_SEQ_RETRIES o quadro trava as regiões (menor índice primeiro, como o passo),
+ * e o match_lock que recebe EOWNERDEAD fecha a seção aberta. */
+void match_copy_frame(Match &sm, char *out) {
+    int ty0 = frame_x0 / region_rows, ty_end = (frame_x0 + frame_rows - 1) / region_rows + 1;
+    int tx0 = frame_y0 / region_cols, tx_end = (frame_y0 + frame_cols - 1) / region_cols + 1;
+    auto copy = [&] {
+        for (int i = 0; i < frame_rows; i++) memcpy(out + (size_t)i * frame_cols, &sm.view(frame_x0 + i, frame_y0), frame_cols);
+    };
+    if (seq_read(ty0, ty_end, tx0, tx_end, [&sm](int r) -> atomic<uint32_t> & { return sm.regions()[r].seq; }, copy,
+                 MATCH_SEQ_RETRIES) == SEQ_READ_GAVE_UP) {
+        for (int ty = ty0; ty < ty_end; ty++)
+            for (int tx = tx0; tx < tx_end; tx++) match_lock(sm, ty * tiles_x + tx);
+        copy();
+        for (int ty = ty0; ty < ty_end; ty++)
+            for (int tx = tx0; tx < tx_end; tx++) match_unlock(sm, ty * tiles_x + tx);
+        sm.locked_frames.fetch_add(1, memory_order_relaxed);
     }
+    sm.frames.fetch_add(1, memory_order_relaxed);
+}
 
-    if (!allow_move(nx, ny)) return; // Chama validação para verificar permissão. No jogo, aborta se for parede.
-
-    /* Entrada na Seção Crítica de DADOS: Solicita acesso exclusivo à matriz */
-    unique_lock<mutex> lock(mtx_map); // Adquire mutex mtx_map para entrar em exclusão mútua. No jogo, garante que ninguém mexa no mapa agora.
-
-    char next_base = base_map[nx][ny];      // Lê terreno futuro para lógica. No jogo, identifica se é ponte ou chão.
-    char current_base = base_map[p.x][p.y]; // Lê terreno atual para lógica. No jogo, usado para apagar rastro.
+/* draw_map lendo o segmento compartilhado (processo renderizador) */
+void match_draw(Match &sm) {
+    pair<int, int> pos[2]; // Jogadores de teclado: x, y escritos por outro processo (leitura atômica, só para a janela)
+    int n = min(sm.nplayers, 2);
+    for (int i = 0; i < n; i++)
+        pos[i] = {__atomic_load_n(&sm.players()[i].x, __ATOMIC_RELAXED), __atomic_load_n(&sm.players()[i].y, __ATOMIC_RELAXED)};
+    follow_positions(pos, n);
+    STAT_TIMER(s_frame, H_FRAME);
+    STAT_TIMER(s_copy, H_DRAW_COPY);
+    uint64_t t0 = now_ns();
+    match_copy_frame(sm, frame_next.data());
+    render_stats.copy.record(now_ns() - t0);
+    STAT_ELAPSED(H_DRAW_COPY, s_copy);
+    present_frame();
+    STAT_COUNT(S_FRAMES);
+    STAT_ELAPSED(H_FRAME, s_frame);
+}
 
-    // --- LÓGICA DO SEMÁFORO (Região Crítica do Jogo) ---
-    /* Verifica se está entrando na Ponte ('C') vindo de fora */
-    if (next_base == 'C' && current_base != 'C') {
-        /* Operação WAIT (TryWait) NO SEMÁFORO: Tenta entrar na RC Lógica */
-        if (sem_trywait(&sem_RC) != 0) { // Tenta decrementar semáforo para verificar disponibilidade. No jogo, se falhar, jogador é impedido de entrar.
-            return; // Retorna erro para cancelar função. No jogo, o personagem "bate" na entrada e espera.
-        }
+/* Linhas do painel 'i' no modo --procs: contadores que cada processo de jogador mantém no segmento,
+ * mais o desenho, medido aqui no processo renderizador */
+void match_overlay_lines(Match &sm, vector<string> &lines) {
+    char buf[96];
+    for (int i = 0; i < sm.nplayers; i++) {
+        MatchPlayer &p = sm.players()[i];
+        snprintf(buf, sizeof buf, " jogador %c%s: tentativas %llu  movimentos %llu  disputas %llu ", p.symbol,
+                 p.alive.load() ? "" : " (morto)", (unsigned long long)p.attempts.load(memory_order_relaxed),
+                 (unsigned long long)p.moved.load(memory_order_relaxed), (unsigned long long)p.contended.load(memory_order_relaxed));
+        lines.push_back(buf);
     }
-    // ----------------------------------------------------
+    snprintf(buf, sizeof buf, " mutexes recuperados %llu  quadros %llu ", (unsigned long long)sm.recovered.load(),
+             (unsigned long long)sm.frames.load(memory_order_relaxed));
+    lines.push_back(buf);
+    snprintf(buf, sizeof buf, " copia do quadro p50 %lluns p99 %lluns ", (unsigned long long)render_stats.copy.percentile(50),
+             (unsigned long long)render_stats.copy.percentile(99));
+    lines.push_back(buf);
+}
 
-    /* Verificação de Vitória */
-    int mid_col = COL / 2; // Calcula meio do mapa para definir fronteira. No jogo, separa os lados de vitória.
-    if (p.symbol == '1' && next_base == 'F' && ny > mid_col) { // Verifica condição P1 para checar alvo. No jogo, define fim da partida.
-        playing = false; // Seta flag false para sinalizar parada. No jogo, encerra o loop principal.
-        winner_msg = "PLAYER 1 VENCEU!"; // Define string para output. No jogo, anuncia o vencedor.
-    }
-    else if (p.symbol == '2' && next_base == 'F' && ny < mid_col) { // Verifica condição P2 para checar alvo. No jogo, define fim da partida.
-        playing = false; // Seta flag false para sinalizar parada. No jogo, encerra o loop principal.
-        winner_msg = "PLAYER 2 VENCEU!"; // Define string para output. No jogo, anuncia o vencedor.
+/* Processo (ou thread) de um jogador de teclado: consome a fila no segmento, no ritmo do jogo */
+void shm_input_loop(Match &sm, int i) {
+    MatchPlayer &p = sm.players()[i];
+    Command cmd;
+    while (sm.playing.load(memory_order_relaxed)) {
+        if (p.input.pop(cmd, coalesce_policy)) {
+            if (match_move(sm, i, cmd.dir)) p.moved.store(p.moved.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            p.attempts.store(p.attempts.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            this_thread::sleep_for(chrono::milliseconds(move_delay_ms));
+        } else {
+            this_thread::sleep_for(chrono::milliseconds(idle_delay_ms));
+        }
     }
+}
 
-    /* Flag auxiliar para saber se deve liberar o semáforo depois */
-    bool just_exited_critical = (current_base == 'C' && next_base != 'C'); // Avalia saída para lógica booleana. No jogo, true se saiu da ponte agora.
-
-    /* Atualização Visual do Mapa (Memória Compartilhada) */
-    // Só restauramos a célula antiga se ela ainda contém o símbolo deste jogador.
-    if (map_view[p.x][p.y] == p.symbol) { 
-        map_view[p.x][p.y] = current_base; // Restaura chão para limpar posição. No jogo, apaga o rastro do jogador.
+/* Processo (ou thread) de um bot aleatório, até o fim da partida. Com crash_after > 0, morre
+ * (SIGKILL) depois desse número de tentativas segurando o mutex da própria região; com mid_write,
+ * no meio do próximo passo (seqlock ímpar e o jogador fora das duas células). */
+void shm_bot_loop(Match &sm, int i, uint64_t rng, uint64_t crash_after, bool mid_write = false) {
+    MatchPlayer &p = sm.players()[i];
+    Bot bot;
+    bot.rng = rng;
+    uint64_t n = 0;
+    while (sm.playing.load(memory_order_relaxed)) {
+        if (match_move(sm, i, bot.decide(p.x, p.y))) p.moved.store(p.moved.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        p.attempts.store(++n, memory_order_relaxed);
+        if (n == crash_after) {
+            while (mid_write && sm.playing.load(memory_order_relaxed)) match_move(sm, i, bot.decide(p.x, p.y), true);
+            match_lock(sm, region_of(p.x, p.y));
+            raise(SIGKILL);
+        }
     }
-    p.x = nx; // Atualiza struct X para efetivar valor. No jogo, jogador muda de posição lógica.
-    p.y = ny; // Atualiza struct Y para efetivar valor. No jogo, jogador muda de posição lógica.
-    
-    // Desenha jogador na nova posição (isso pode sobrescrever o outro jogador: último escritor vence - permite ultrapassar)
-    map_view[p.x][p.y] = p.symbol; // Escreve na matriz para renderizar. No jogo, atualiza a posição visual.
-
-    lock.unlock(); 
-    /* Saída da Seção Crítica de DADOS: Libera o mutex manualmente para permitir desenho */
+}
 
-    if (just_exited_critical) {
-        /* Operação POST (Signal) NO SEMÁFORO: Libera a RC Lógica */
-        sem_post(&sem_RC); // Incrementa semáforo para sinalizar "livre". No jogo, permite que outro jogador entre na ponte.
+/* Cria um processo filho que executa body e sai sem rodar destrutores/atexit do pai */
+template <class F>
+pid_t shm_fork(F body) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        body();
+        _exit(0);
     }
+    return pid;
 }
 
-// FUNÇÃO DA THREAD
-/* Loop de execução de cada jogador */
-void thread_player(Player &p) {
-    while (playing) { // Verifica flag global para manter thread. No jogo, define a vida útil do jogador.
-        if (p.direction != ' ') { // Checa input para verificar intenção. No jogo, evita processamento inútil se parado.
-            move_player(p); // Chama função lógica para tentar mover. No jogo, executa as regras de movimento.
-            p.direction = ' '; // Reseta direção para consumir input. No jogo, aguarda nova tecla.
-            this_thread::sleep_for(chrono::milliseconds(100)); // Executa sleep para controlar velocidade. No jogo, define o ritmo/dificuldade.
-        } else {
-             this_thread::sleep_for(chrono::milliseconds(10)); // Executa sleep curto para evitar CPU 100%. No jogo, economiza recursos enquanto ocioso.
+/* Supervisor: colhe filhos que terminaram; os mortos por sinal são limpos com match_reap.
+ * Devolve quantos jogadores foram colhidos mortos nesta chamada. */
+int shm_supervise(Match &sm, bool block) {
+    int crashed = 0, status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, block ? 0 : WNOHANG)) > 0) {
+        for (int i = 0; i < sm.nplayers; i++) {
+            MatchPlayer &p = sm.players()[i];
+            if (p.pid != pid) continue;
+            p.pid = 0;
+            if (WIFSIGNALED(status)) {
+                match_reap(sm, i);
+                crashed++;
+            }
         }
     }
+    return crashed;
 }
 
+#ifndef HEADLESS
 /* Função main a seguir para coordenar os comandos do jogo */
-int main() {
-    /* Inicializa o mapa visual com a base estática */
-    for (int i = 0; i < LIN; i++) {
-        for (int j = 0; j < COL; j++) {
-            map_view[i][j] = base_map[i][j]; // Copia bytes para clonar mapa. No jogo, prepara estado inicial do cenário.
+int main(int argc, char **argv) {
+    bool events = false;     // --events: laço único com epoll/timerfd em vez de uma thread por jogador
+    bool procs = false;      // --procs: um processo por jogador, estado em memória compartilhada
+    string record_path;      // --record: grava o replay da partida
+    EventLoopConfig ev_cfg;
+    for (int i = 1; i < argc; i++) { // Opções de linha de comando
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--coalesce" && has_value && parse_coalesce(argv[i + 1], coalesce_policy)) i++;
+        else if (arg == "--events") events = true;
+        else if (arg == "--procs") procs = true;
+        else if (arg == "--tick-ms" && has_value && atol(argv[i + 1]) > 0) ev_cfg.tick_us = atol(argv[++i]) * 1000;
+        else if (arg == "--fps" && has_value && atoi(argv[i + 1]) > 0) ev_cfg.render_fps = atoi(argv[++i]);
+        else if (arg == "--tile" && has_value && parse_tile(argv[i + 1], tile_rows, tile_cols)) i++;
+        else if (arg == "--map" && has_value) {
+            string err;
+            if (!load_map(argv[++i], err)) { cerr << err << "\n"; return 2; }
+        }
+        else if (arg == "--record" && has_value) record_path = argv[++i];
+        else if (parse_bridge_option(argc, argv, i, ok) && ok) continue;
+        else if (parse_stats_option(argc, argv, i, ok) && ok) continue;
+        else {
+            cerr << "Uso: " << argv[0] << " [--coalesce none|latest|repeat] [--events [--tick-ms N] [--fps N]] [--procs] [--tile RxC]\n"
+                 << "       [--bridge-capacity N] [--bridge-order fifo|none] [--convoy N] [--map ARQUIVO] [--record ARQUIVO]\n"
+                 << "       [--stats-dump ARQUIVO|unix:/caminho] [--stats-interval-ms N]\n";
+            return 2;
         }
     }
-
-    /* Inicialização do Semáforo POSIX */
-    sem_init(&sem_RC, 0, 1); // Cria semáforo com valor 1 para definir escopo. No jogo, garante Exclusão Mútua na ponte.
+    if (procs && (events || !record_path.empty())) {
+        cerr << "--procs nao combina com --events nem com --record\n";
+        return 2;
+    }
+    if (procs && bridge_admission_set) { // Na Match a ponte é só o semáforo: sem senhas nem comboios
+        cerr << "--procs nao combina com --bridge-order nem com --convoy\n";
+        return 2;
+    }
 
     Player p1 = {1, 1, '1', ' '};   // Instancia P1 para criar objeto. No jogo, define posição inicial esquerda.
     Player p2 = {19, 58, '2', ' '}; // Instancia P2 para criar objeto. No jogo, define posição inicial direita.
+    Histogram input_lat1, input_lat2; // Latência tecla -> movimento de cada jogador
+    p1.input_lat = &input_lat1;
+    p2.input_lat = &input_lat2;
+    reset_match(p1, p2); // Copia o mapa, cria o semáforo e posiciona os jogadores.
+    ReplayRecorder rec;
+    if (!record_path.empty()) { // Grava os movimentos desde a largada
+        rec.begin({&p1, &p2}, 0);
+        recorder = &rec;
+    }
+    auto save_replay = [&] {
+        if (recorder && !rec.finish(record_path)) cerr << "falha ao gravar " << record_path << "\n";
+    };
+    StatsDumper dumper; // Linhas periódicas de estatísticas (se --stats-dump); a última sai ao encerrar
 
-    map_view[p1.x][p1.y] = '1'; // Escreve na matriz para atualizar P1. No jogo, mostra P1 na largada.
-    map_view[p2.x][p2.y] = '2'; // Escreve na matriz para atualizar P2. No jogo, mostra P2 na largada.
+    if (procs) { // Cada jogador num processo; esta main vira o processo renderizador/teclado
+        Match *sm = shm_create({&p1, &p2});
+        if (!sm) { perror("mmap"); return 1; }
+        for (int i = 0; i < 2; i++) sm->players()[i].pid = shm_fork([sm, i] { shm_input_loop(*sm, i); }); // Antes do ncurses: filhos não tocam no terminal
+        if (!start_stats_dump(dumper)) { // Depois do fork: os filhos não herdam a thread do dump (nem um lock dela)
+            sm->playing = 0;
+            shm_supervise(*sm, true);
+            shm_destroy(sm);
+            return 2;
+        }
+        stats_overlay_source = [sm](vector<string> &lines) { match_overlay_lines(*sm, lines); };
+        init_interface();
+        view_rows = LINES;
+        view_cols = COLS;
+        invalidate_frame();
+        int dead = 0;
+        while (sm->playing) {
+            match_draw(*sm); // Lê o mapa direto do segmento compartilhado
+            int ch;
+            while ((ch = getch()) != ERR) handle_key(ch, sm->players()[0].input, sm->players()[1].input);
+            if (!playing) sm->playing = 0; // 'q'
+            dead += shm_supervise(*sm, false); // Jogador que caiu some do mapa; a partida segue com o outro
+            if (dead == 2) sm->playing = 0;
+            this_thread::sleep_for(chrono::milliseconds(30));
+        }
+        match_draw(*sm);
+        dead += shm_supervise(*sm, true); // Espera os processos dos jogadores saírem
+        close_interface();
+        dumper.stop();
+        int w = sm->winner;
+        if (w >= 0) winner_msg = sm->players()[w].symbol == '1' ? "PLAYER 1 VENCEU!" : "PLAYER 2 VENCEU!";
+        cout << "\n===========================\n";
+        cout << "   " << winner_msg << "   \n";
+        cout << "===========================\n";
+        cout << "Processos: " << sm->nplayers << " jogadores | mortos: " << dead
+             << " | mutexes recuperados: " << sm->recovered << " | quadros: " << sm->frames << "\n";
+        for (int i = 0; i < sm->nplayers; i++)
+            cout << "Jogador " << sm->players()[i].symbol << ": " << sm->players()[i].moved << " movimentos em "
+                 << sm->players()[i].attempts << " tentativas | mutex disputado: " << sm->players()[i].contended << "\n";
+        shm_destroy(sm);
+        destroy_bridges();
+        return 0;
+    }
+    if (!start_stats_dump(dumper)) return 2;
 
     init_interface(); // Inicia ncurses para configurar TUI. No jogo, entra no modo gráfico textual.
+    view_rows = LINES;  // Desenha só o que cabe no terminal. No jogo, mapas grandes não estouram a tela.
+    view_cols = COLS;
+    invalidate_frame();
+    Player *camera[2] = {&p1, &p2};
+    camera_players = camera; // Mapa maior que o terminal: a janela rola para acompanhar os jogadores
+    camera_n = 2;
+
+    if (events) { // Modo orientado a eventos: simulação e desenho na thread principal, sem sleep
+        Player *players[2] = {&p1, &p2};
+        EventLoopStats ev_stats;
+        string err;
+        bool ok = run_event_loop(players, 2, ev_cfg, ev_stats, err);
+        close_interface();
+        if (!ok) { // Terminal já restaurado: a mensagem não se perde na tela do ncurses
+            cerr << "modo eventos indisponivel: " << err << "\n";
+            dumper.stop();
+            destroy_bridges();
+            return 1;
+        }
+        dumper.stop();
+        save_replay();
+        destroy_bridges();
+        cout << "\n===========================\n";
+        cout << "   " << winner_msg << "   \n";
+        cout << "===========================\n";
+        cout << "Acordadas: " << ev_stats.wakeups << " (ociosas: " << ev_stats.idle_wakeups << ")"
+             << " | ticks: " << ev_stats.sim_ticks << " (perdidos: " << ev_stats.missed_ticks << ")"
+             << " | quadros: " << ev_stats.frames << "\n";
+        cout << "Jitter do tick (us):\n";
+        ev_stats.jitter.print(cout, "us", 1000);
+        print_bridge_stats(cout);
+        return 0;
+    }
 
     /* Criação e Disparo das Threads (Paralelismo) */
     thread t1(thread_player, ref(p1)); // Cria thread t1 para rodar função. No jogo, P1 começa a existir em paralelo.
@@ -341,21 +3106,9 @@ int main() {
     while (playing) { // Loop while para manter engine. No jogo, verifica se partida continua.
         draw_map(); // Chama draw_map para renderizar. No jogo, atualiza tela para usuário.
 
-        int ch = getch(); // Lê teclado para capturar input. No jogo, controla os personagens.
-        if (ch != ERR) { // Verifica buffer para ver se há tecla. No jogo, processa comando se houver.
-            switch(ch) {
-                case 'w': p1.direction = 'u'; break; // Seta direção para registrar comando. No jogo, P1 vai para cima.
-                case 's': p1.direction = 'd'; break; // Seta direção para registrar comando. No jogo, P1 vai para baixo.
-                case 'a': p1.direction = 'l'; break; // Seta direção para registrar comando. No jogo, P1 vai para esquerda.
-                case 'd': p1.direction = 'r'; break; // Seta direção para registrar comando. No jogo, P1 vai para direita.
-                
-                case KEY_UP:    p2.direction = 'u'; break; // Seta direção para registrar comando. No jogo, P2 vai para cima.
-                case KEY_DOWN:  p2.direction = 'd'; break; // Seta direção para registrar comando. No jogo, P2 vai para baixo.
-                case KEY_LEFT:  p2.direction = 'l'; break; // Seta direção para registrar comando. No jogo, P2 vai para esquerda.
-                case KEY_RIGHT: p2.direction = 'r'; break; // Seta direção para registrar comando. No jogo, P2 vai para direita.
-                
-                case 'q': playing = false; break; // Altera flag para encerrar. No jogo, sai do programa.
-            }
+        int ch;
+        while ((ch = getch()) != ERR) { // Lê todas as teclas pendentes. No jogo, rajadas de teclas não se perdem entre quadros.
+            handle_key(ch, p1.input, p2.input); // Enfileira o comando do jogador correspondente. No jogo, controla os personagens.
         }
         this_thread::sleep_for(chrono::milliseconds(30)); // Frame limiter para controlar FPS. No jogo, evita flickering excessivo.
     }
@@ -364,13 +3117,1458 @@ int main() {
     t1.join(); // Join na t1 para bloquear main. No jogo, garante fim ordenado de P1.
     t2.join(); // Join na t2 para bloquear main. No jogo, garante fim ordenado de P2.
     close_interface(); // Fecha ncurses para limpar recursos. No jogo, restaura terminal.
-    
+    dumper.stop();
+    save_replay(); // Estado final no rodapé do replay (se --record)
+
     /* Destruição do recurso do Semáforo */
-    sem_destroy(&sem_RC); // Destrói semáforo para liberar memória. No jogo, evita vazamento de recursos.
+    destroy_bridges(); // Destrói os semáforos das pontes para liberar memória. No jogo, evita vazamento de recursos.
 
     cout << "\n===========================\n"; // Print stream para mostrar texto. No jogo, feedback pós-jogo.
     cout << "   " << winner_msg << "   \n"; // Print stream para mostrar vencedor. No jogo, exibe resultado.
     cout << "===========================\n"; // Print stream para mostrar texto. No jogo, feedback pós-jogo.
 
+    Player *players[2] = {&p1, &p2};
+    for (Player *p : players) { // Resumo da fila de entrada de cada jogador
+        cout << "Jogador " << p->symbol << ": " << p->input_lat->total << " movimentos"
+             << " | perdidos: " << p->input.dropped << " | agrupados: " << p->input.coalesced
+             << " | latencia tecla->mapa p50/p99: " << p->input_lat->percentile(50) / 1000 << "/"
+             << p->input_lat->percentile(99) / 1000 << " us\n";
+    }
+    print_bridge_stats(cout); // Ocupação, admissões e espera em cada ponte
+    if (render_stats.frames) { // Resumo da renderização incremental
+        cout << "Quadros: " << render_stats.frames
+             << " | celulas/quadro: " << (double)render_stats.cells / render_stats.frames
+             << " | bytes/quadro: " << (double)render_stats.bytes / render_stats.frames
+             << " | copia do quadro p99: " << render_stats.copy.percentile(99) << " ns\n";
+    }
+
     return 0; // Retorna 0 para finalizar main. No jogo, programa encerra com sucesso.
-}
\ No newline at end of file
+}
+#else // HEADLESS
+
+// --- MODO HEADLESS (BENCHMARK) ---
+// Executa partidas completas sem ncurses, com bots no lugar do teclado e sem os atrasos de
+// ritmo, medindo o custo real do mutex e do semáforo. Pensado para rodar em CI (sem TTY).
+
+/* Calcula, por busca em largura na grade, o caminho mais curto de (sx, sy) até uma
+ * bandeira 'F' do lado oposto, devolvido como roteiro de comandos ('u', 'd', 'l', 'r'). */
+string shortest_path_script(int sx, int sy, bool target_right) {
+    const int dx[4] = {-1, 1, 0, 0};
+    const int dy[4] = {0, 0, -1, 1};
+    const int ncols = grid.cols;
+    vector<int> parent((size_t)grid.rows * ncols, -1); // Índice da célula anterior no caminho (-1 = não visitada)
+    vector<int> queue_cells;
+    int start = sx * ncols + sy;
+    parent[start] = start;
+    queue_cells.push_back(start);
+    for (size_t head = 0; head < queue_cells.size(); head++) {
+        int cur = queue_cells[head];
+        int x = cur / ncols, y = cur % ncols;
+        if (terrain_at(x, y) == T_FLAG && (target_right ? y > ncols / 2 : y < ncols / 2)) {
+            string script;
+            while (cur != start) { // Reconstrói o caminho de trás para frente
+                int prev = parent[cur];
+                int d = cur - prev;
+                script += d == -ncols ? 'u' : d == ncols ? 'd' : d == -1 ? 'l' : 'r';
+                cur = prev;
+            }
+            reverse(script.begin(), script.end());
+            return script;
+        }
+        for (int k = 0; k < 4; k++) {
+            int nx = x + dx[k], ny = y + dy[k];
+            if (nx < 0 || nx >= grid.rows || ny < 0 || ny >= ncols || is_wall(nx, ny)) continue;
+            int next = nx * ncols + ny;
+            if (parent[next] != -1) continue;
+            parent[next] = cur;
+            queue_cells.push_back(next);
+        }
+    }
+    return ""; // Sem caminho: o bot cai no passeio aleatório
+}
+
+/* Imprime o uso do binário de benchmark */
+static void usage(const char *prog) {
+    cerr << "Uso: " << prog << " events [--tick-us U] [--fps N] [--ticks N] [--map ARQUIVO] | --idle-ms N [--keys-per-s K]\n"
+         << "     " << prog << " scale [--players 2,16,128,1024] [--workers 1,2,4] [--duration-ms N] [--seed S] [--tile RxC] [--map ARQUIVO]\n"
+         << "     " << prog << " procs [--players 2,16,64] [--mode threads,procs] [--duration-ms N] [--crash-after N [--crash-mid-write]] [--render]\n"
+         << "     " << prog << " tournament [--matches 1000,10000,100000] [--concurrent C] [--workers W] [--max-ticks N]\n"
+         << "     " << prog << " snapshot [--readers 0,1,2,4,8,16] [--mode seqlock,lock] [--players N] [--reader-hz H]\n"
+         << "     " << prog << " gen-map --rows R --cols C [--bridges K] [--seed S] --out ARQUIVO\n"
+         << "     " << prog << " layout [--map ARQUIVO] [--agents N] [--steps N] [--seed S]\n"
+         << "     " << prog << " bitboard [--sizes 64,256,1024,4096] [--queries N] [--fills N] [--seed S]\n"
+         << "     " << prog << " replay [--map ARQUIVO] [--repeat N] REPLAY...\n"
+         << "     " << prog << " convoy\n"
+         << "     " << prog << " field [--sizes 256,1024,4096] [--bots 16,256,4096] [--decisions N] [--bridges K] [--seed S]\n"
+         << "     " << prog << " [--matches N] [--bot script|random] [--max-ticks N] [--seed S] [--render|--render-locks]\n"
+         << "       [--burst N] [--burst-gap-us U] [--coalesce none|latest|repeat] [--move-delay MS] [--map ARQUIVO] [--record DIR]\n"
+         << "  --matches N    numero de partidas (padrao 10000)\n"
+         << "  --bot TIPO     script: caminho mais curto ate a bandeira; random: passeio aleatorio;\n"
+         << "                 field: campo de distancias compartilhado pelo time (padrao script)\n"
+         << "  --max-ticks N  tentativas de movimento por partida antes de declarar empate (padrao 100000)\n"
+         << "  --seed S       semente dos bots aleatorios (padrao 1)\n"
+         << "  --render       roda o renderizador (sem terminal) em paralelo e reporta celulas/bytes por quadro\n"
+         << "  --render-locks o renderizador trava as regioes do mapa em vez de copiar pelo seqlock\n"
+         << "  --burst N      a main faz o papel do teclado: enfileira rajadas de N comandos por jogador\n"
+         << "                 (bot padrao random; com --bot script os roteiros enviam um passo por vez)\n"
+         << "  --burst-gap-us intervalo entre rajadas em microssegundos (padrao 1000)\n"
+         << "  --coalesce P   politica de agrupamento da fila de entrada (padrao none)\n"
+         << "  --move-delay M pausa apos cada movimento em ms (padrao 0; o jogo usa 100)\n"
+         << "  --bridge-capacity N  vagas por ponte (padrao 1)\n"
+         << "  --bridge-order O     fifo (senhas por ordem de chegada, padrao) ou none (quem tentar primeiro)\n"
+         << "  --convoy N           comboios de mesmo sentido: ate N admissoes passando a frente do sentido oposto\n"
+         << "  --map ARQUIVO        mapa de arquivo texto no lugar do mapa embutido (veja gen-map)\n"
+         << "  --record DIR         grava o replay de cada partida em DIR/match-NNNNNN.rsr\n"
+         << "  --stats-dump DESTINO uma linha de contadores/percentis por intervalo em ARQUIVO ou unix:/caminho\n"
+         << "  --stats-interval-ms N intervalo entre linhas do dump (padrao 1000)\n";
+}
+
+/* Carrega o mapa pedido em --map, reportando o erro */
+static bool open_map(const char *path) {
+    string err;
+    if (load_map(path, err)) return true;
+    cerr << err << "\n";
+    return false;
+}
+
+/* Cenário ocioso de bench events: dois jogadores só de teclado e keys_per_s teclas por segundo vindas
+ * de um pipe, durante duration_ms. Roda o loop de eventos e, com as mesmas teclas, as threads com
+ * sleep_for do jogo (pausas de 100 ms após mover e 10 ms sem comando), e compara as acordadas por segundo. */
+static int bench_events_idle(const EventLoopConfig &cfg, long duration_ms, long keys_per_s) {
+    /* Escreve as teclas (alternando jogadores e direções) em fd, ou direto nas filas se fd < 0 */
+    auto feed = [duration_ms, keys_per_s](int fd, Player **players, long &keys) {
+        const char dirs[4] = {'u', 'r', 'd', 'l'};
+        uint64_t end = now_ns() + (uint64_t)duration_ms * 1000000;
+        uint64_t gap = keys_per_s ? 1000000000ULL / (uint64_t)keys_per_s : 0;
+        for (uint64_t next = now_ns() + gap; gap && next < end; next += gap, keys++) {
+            this_thread::sleep_for(chrono::nanoseconds(next - now_ns()));
+            char rec[2] = {(char)(keys % 2), dirs[(keys / 2) % 4]};
+            if (fd >= 0) { if (write(fd, rec, 2) != 2) break; }
+            else players[(int)rec[0]]->input.push({rec[1], now_ns()});
+        }
+        uint64_t now = now_ns();
+        if (now < end) this_thread::sleep_for(chrono::nanoseconds(end - now));
+    };
+    max_ticks = 0;
+    end_on_win = false; // Duração fixa
+    Player p1 = {1, 1, '1', ' '};
+    Player p2 = {19, 58, '2', ' '};
+    Player *players[2] = {&p1, &p2};
+
+    /* Loop de eventos: o teclado é um pipe; fechar a escrita encerra a partida */
+    reset_match(p1, p2);
+    int pipefd[2];
+    if (pipe(pipefd) < 0) { perror("pipe"); destroy_bridges(); return 1; }
+    EventLoopConfig ecfg = cfg;
+    ecfg.input_fd = pipefd[0];
+    EventLoopStats st;
+    string err;
+    long keys = 0;
+    uint64_t start = now_ns();
+    thread feeder([&] {
+        feed(pipefd[1], players, keys);
+        close(pipefd[1]);
+    });
+    bool ok = run_event_loop(players, 2, ecfg, st, err);
+    feeder.join();
+    close(pipefd[0]);
+    double ev_secs = (double)(now_ns() - start) / 1e9;
+    destroy_bridges();
+    if (!ok) {
+        cerr << err << "\n";
+        return 1;
+    }
+
+    /* Threads do jogo, mesmas teclas */
+    reset_match(p1, p2);
+    move_delay_ms = 100;
+    idle_delay_ms = 10;
+    long thread_keys = 0;
+    start = now_ns();
+    thread t1(thread_player, ref(p1));
+    thread t2(thread_player, ref(p2));
+    feed(-1, players, thread_keys);
+    playing = false;
+    t1.join();
+    t2.join();
+    double th_secs = (double)(now_ns() - start) / 1e9;
+    destroy_bridges();
+    uint64_t th_wakeups = p1.attempts + p1.idle_polls + p2.attempts + p2.idle_polls;
+
+    cout << "scenario=idle keys_per_s=" << keys_per_s << " duration_ms=" << duration_ms << "\n"
+         << "keys=" << keys << "\n"
+         << "events_sim_ticks=" << st.sim_ticks << "\n"
+         << "events_wakeups=" << st.wakeups << "\n"
+         << "events_idle_wakeups=" << st.idle_wakeups << "\n"
+         << "events_wakeups_per_s=" << (double)st.wakeups / ev_secs << "\n"
+         << "threads_wakeups=" << th_wakeups << "\n"
+         << "threads_wakeups_per_s=" << (double)th_wakeups / th_secs << "\n";
+    return 0;
+}
+
+/* Benchmark do modo eventos: bots jogando em ticks fixos, sem teclado.
+ * Mede acordadas do epoll e o jitter dos ticks. Com --idle-ms, o cenário ocioso (bench_events_idle). */
+static int bench_events(int argc, char **argv) {
+    EventLoopConfig cfg;
+    cfg.tick_us = 1000;
+    cfg.render_fps = 0;
+    cfg.read_stdin = false;
+    max_ticks = 0;
+    long sim_ticks = 5000;
+    long idle_ms = 0, keys_per_s = 2;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--tick-us" && has_value) cfg.tick_us = atol(argv[++i]);
+        else if (arg == "--fps" && has_value) cfg.render_fps = atoi(argv[++i]);
+        else if (arg == "--ticks" && has_value) sim_ticks = atol(argv[++i]);
+        else if (arg == "--idle-ms" && has_value) idle_ms = atol(argv[++i]);
+        else if (arg == "--keys-per-s" && has_value) keys_per_s = atol(argv[++i]);
+        else if (arg == "--map" && has_value) { if (!open_map(argv[++i])) return 2; }
+        else { sim_ticks = 0; break; } // Opção desconhecida: cai no uso abaixo
+    }
+    if (cfg.tick_us <= 0 || cfg.render_fps < 0 || sim_ticks <= 0 || idle_ms < 0 || keys_per_s < 0) {
+        cerr << "Uso: " << argv[0] << " events [--tick-us U] [--fps N] [--ticks N] [--map ARQUIVO]\n"
+             << "       " << argv[0] << " events --idle-ms N [--keys-per-s K] [--tick-us U]\n";
+        return 2;
+    }
+    if (idle_ms) return bench_events_idle(cfg, idle_ms, keys_per_s);
+
+    Player p1 = {1, 1, '1', ' '};
+    Player p2 = {19, 58, '2', ' '};
+    Bot b1, b2; // Passeio aleatório: a partida dura até o limite de ticks
+    b1.rng = 1;
+    b2.rng = 2;
+    p1.bot = &b1;
+    p2.bot = &b2;
+    reset_match(p1, p2);
+    max_ticks = sim_ticks * 2; // step_player conta uma tentativa por jogador
+    Player *players[2] = {&p1, &p2};
+    EventLoopStats st;
+    string err;
+    uint64_t start = now_ns();
+    if (!run_event_loop(players, 2, cfg, st, err)) {
+        cerr << err << "\n";
+        destroy_bridges();
+        return 1;
+    }
+    double secs = (double)(now_ns() - start) / 1e9;
+    destroy_bridges();
+
+    cout << "sim_ticks=" << st.sim_ticks << "\n"
+         << "missed_ticks=" << st.missed_ticks << "\n"
+         << "wakeups=" << st.wakeups << "\n"
+         << "idle_wakeups=" << st.idle_wakeups << "\n"
+         << "wakeups_per_tick=" << (double)st.wakeups / (double)max<uint64_t>(st.sim_ticks, 1) << "\n"
+         << "frames=" << st.frames << "\n"
+         << "elapsed_s=" << secs << "\n"
+         << "jitter_p50_ns=" << st.jitter.percentile(50) << "\n"
+         << "jitter_p99_ns=" << st.jitter.percentile(99) << "\n"
+         << "jitter_histogram_us:\n";
+    st.jitter.print(cout, "us", 1000);
+    return 0;
+}
+
+/* Lê uma lista "a,b,c" de inteiros positivos */
+static bool parse_list(const char *text, vector<int> &out, int min_value = 1) {
+    out.clear();
+    string item;
+    for (const char *c = text; ; c++) {
+        if (*c == ',' || *c == '\0') {
+            if (item.empty() || atoi(item.c_str()) < min_value) return false;
+            out.push_back(atoi(item.c_str()));
+            item.clear();
+            if (!*c) return true;
+        } else item += *c;
+    }
+}
+
+/* Benchmark de escala: jogadores x workers -> movimentos/s e disputa pelos mutexes do mapa */
+static int bench_scale(int argc, char **argv) {
+    vector<int> player_counts = {2, 16, 128, 1024};
+    vector<int> worker_counts;
+    int cores = max(1, (int)thread::hardware_concurrency());
+    for (int w = 1; w < cores; w *= 2) worker_counts.push_back(w);
+    worker_counts.push_back(cores);
+    long duration_ms = 500;
+    uint64_t seed = 1;
+    int show_regions = 3;
+    bool field_bots = false; // --bot field: bots descem o campo de distâncias do time
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--players" && has_value) ok = parse_list(argv[++i], player_counts);
+        else if (arg == "--workers" && has_value) ok = parse_list(argv[++i], worker_counts);
+        else if (arg == "--duration-ms" && has_value) duration_ms = atol(argv[++i]);
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--tile" && has_value) ok = parse_tile(argv[++i], tile_rows, tile_cols);
+        else if (arg == "--regions" && has_value) show_regions = atoi(argv[++i]);
+        else if (arg == "--map" && has_value) ok = open_map(argv[++i]);
+        else if (arg == "--bot" && has_value) {
+            string k = argv[++i];
+            field_bots = k == "field";
+            ok = field_bots || k == "random";
+        }
+        else if (arg == "--field-sync-us" && has_value) field_sync_us = atol(argv[++i]);
+        else if (parse_bridge_option(argc, argv, i, ok) || parse_stats_option(argc, argv, i, ok)) {}
+        else ok = false;
+        if (!ok || duration_ms <= 0) {
+            cerr << "Uso: " << argv[0] << " scale [--players 2,16,128,1024] [--workers 1,2,4] [--duration-ms N] [--seed S]\n"
+                 << "       [--tile RxC] [--regions K]   tamanho das regioes de lock; K regioes mais disputadas no relatorio\n"
+                 << "       [--map ARQUIVO] [--bot random|field] [--field-sync-us U]\n"
+                 << "       [--stats-dump ARQUIVO|unix:/caminho] [--stats-interval-ms N]\n";
+            return 2;
+        }
+    }
+
+    max_ticks = 0;
+    end_on_win = false; // Duração fixa: bots que chegam à bandeira seguem andando
+    if (!grid.text) use_default_map();
+    setup_regions(); // Ajusta o tile ao mapa antes de imprimir
+    cout << "cores=" << cores << " map=" << grid.rows << "x" << grid.cols
+         << " tile=" << region_rows << "x" << region_cols << " regions=" << tiles_y * tiles_x << "\n";
+    StatsDumper dumper; // Acumulado de todas as combinações, linha a linha
+    if (!start_stats_dump(dumper)) return 2;
+    for (int n : player_counts) {
+        for (int w : worker_counts) {
+            vector<unique_ptr<Player>> players;
+            vector<unique_ptr<Bot>> bots;
+            reset_map();
+            for (auto &b : bridges) b->clear_stats(); // Métricas das pontes por combinação
+            if (!spawn_bots(players, bots, n, seed)) { cerr << "mapa sem chao livre na metade de um dos times\n"; return 2; }
+            if (field_bots && !team_fields[0]) setup_fields();
+            for (size_t i = 0; field_bots && i < bots.size(); i++) {
+                bots[i]->kind = Bot::FIELD;
+                bots[i]->field = team_fields[i % 2].get(); // Pares = time '1'
+            }
+            WorkStealingPool pool(w);
+
+            uint64_t start = now_ns();
+            thread timer([duration_ms] { // Encerra a medição após a duração pedida
+                uint64_t end = now_ns() + (uint64_t)duration_ms * 1000000;
+                while (playing && now_ns() < end) this_thread::sleep_for(chrono::milliseconds(1));
+                playing = false;
+            });
+            run_pool_match(players, pool);
+            timer.join();
+            double secs = (double)(now_ns() - start) / 1e9;
+            destroy_bridges();
+
+            uint64_t moves = 0, attempts = 0;
+            for (auto &p : players) {
+                moves += p->moved; // Só passos que mudaram a posição
+                attempts += p->attempts;
+            }
+            const LockStats &ls = pool.lock_totals;
+            cout << "players=" << n << " workers=" << w
+                 << " moves_per_s=" << (uint64_t)((double)moves / secs)
+                 << " attempts_per_s=" << (uint64_t)((double)attempts / secs);
+            if (stats_enabled) {
+                cout << " contended_pct=" << (ls.acquisitions ? 100.0 * (double)ls.contended / (double)ls.acquisitions : 0.0)
+                     << " lock_wait_pct=" << 100.0 * (double)ls.wait_ns / (secs * 1e9 * w); // Fração do tempo dos workers parada nos mutexes
+            }
+            cout << " steals=" << pool.steals;
+            if (field_bots) { // Reparos dos campos de distância nesta medição
+                uint64_t repairs = 0, repair_ns = 0;
+                for (auto &f : team_fields) {
+                    repairs += f->repairs;
+                    repair_ns += f->repair_ns;
+                    f->repairs = f->repair_ns = 0;
+                }
+                cout << " field_repairs=" << repairs << " field_repair_pct=" << 100.0 * (double)repair_ns / (secs * 1e9);
+            }
+            cout << "\n";
+            if (stats_enabled) print_region_stats(cout, show_regions);
+            print_bridge_stats(cout);
+        }
+    }
+    dumper.stop();
+    return 0;
+}
+
+/* Mesmo jogo de bots aleatórios com cada jogador numa thread ou num processo, sobre o mesmo
+ * segmento compartilhado: compara a vazão de threads x processos e testa a recuperação de um
+ * processo que morre segurando um mutex (--crash-after N). */
+static int bench_procs(int argc, char **argv) {
+    vector<int> player_counts = {2, 16, 64};
+    vector<string> modes = {"threads", "procs"};
+    long duration_ms = 500;
+    uint64_t seed = 1;
+    uint64_t crash_after = 0; // > 0: o processo do jogador 0 morre após N tentativas (só no modo procs)
+    bool crash_mid_write = false; // Morre com o contador de sequência da região ímpar
+    bool render = false;      // Processo renderizador copiando quadros do segmento em paralelo
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--players" && has_value) ok = parse_list(argv[++i], player_counts);
+        else if (arg == "--mode" && has_value) {
+            modes.clear();
+            stringstream list(argv[++i]);
+            for (string m; getline(list, m, ',');) {
+                ok = ok && (m == "threads" || m == "procs");
+                modes.push_back(m);
+            }
+        }
+        else if (arg == "--duration-ms" && has_value) duration_ms = atol(argv[++i]);
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--crash-after" && has_value) crash_after = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--crash-mid-write") crash_mid_write = true;
+        else if (arg == "--render") render = true;
+        else if (arg == "--tile" && has_value) ok = parse_tile(argv[++i], tile_rows, tile_cols);
+        else if (arg == "--map" && has_value) ok = open_map(argv[++i]);
+        else if (parse_bridge_option(argc, argv, i, ok)) {}
+        else ok = false;
+        if (!ok || duration_ms <= 0) {
+            cerr << "Uso: " << argv[0] << " procs [--players 2,16,64] [--mode threads,procs] [--duration-ms N] [--seed S]\n"
+                 << "       [--crash-after N [--crash-mid-write]] [--render] [--tile RxC] [--map ARQUIVO] [--bridge-capacity N]\n";
+            return 2;
+        }
+    }
+    if (bridge_admission_set) {
+        cerr << "procs: --bridge-order e --convoy nao se aplicam (a Match usa so o semaforo da ponte)\n";
+        return 2;
+    }
+    for (int n : player_counts)
+        if (n > 2 * MATCH_MAX_TEAM) {
+            cerr << "procs: no maximo " << 2 * MATCH_MAX_TEAM << " jogadores (" << MATCH_MAX_TEAM << " por time)\n";
+            return 2;
+        }
+
+    end_on_win = false; // Duração fixa
+    if (!grid.text) use_default_map();
+    for (int n : player_counts) {
+        for (const string &mode : modes) {
+            bool as_procs = mode == "procs";
+            vector<unique_ptr<Player>> players;
+            vector<unique_ptr<Bot>> bots;
+            reset_map();
+            if (!spawn_bots(players, bots, n, seed)) { cerr << "mapa sem chao livre na metade de um dos times\n"; return 2; }
+            vector<Player *> starts;
+            for (auto &p : players) starts.push_back(p.get());
+            Match *sm = shm_create(starts);
+            if (!sm) { perror("mmap"); return 1; }
+            frame_rows = grid.rows; // Renderizador sem terminal: o mapa inteiro
+            frame_cols = grid.cols;
+
+            uint64_t start = now_ns();
+            vector<thread> threads;
+            for (int i = 0; i < n; i++) {
+                uint64_t rng = bots[i]->rng;
+                uint64_t crash = as_procs && i == 0 ? crash_after : 0; // Thread que morre derruba o processo inteiro
+                bool mid_write = crash_mid_write;
+                if (as_procs) sm->players()[i].pid = shm_fork([=] { shm_bot_loop(*sm, i, rng, crash, mid_write); });
+                else threads.emplace_back([sm, i, rng] { shm_bot_loop(*sm, i, rng, 0); });
+            }
+            if (render) {
+                auto body = [sm] {
+                    vector<char> frame((size_t)frame_rows * frame_cols);
+                    while (sm->playing.load(memory_order_relaxed)) match_copy_frame(*sm, frame.data());
+                };
+                if (as_procs) shm_fork(body); // Colhido pelo supervisor junto com os jogadores
+                else threads.emplace_back(body);
+            }
+
+            int crashed = 0;
+            uint64_t moves_at_crash = 0;
+            uint64_t end = start + (uint64_t)duration_ms * 1000000;
+            while (now_ns() < end) { // Supervisor
+                if (as_procs && shm_supervise(*sm, false)) {
+                    crashed++;
+                    for (int i = 0; i < n; i++) moves_at_crash += sm->players()[i].moved;
+                }
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+            sm->playing = 0;
+            for (auto &t : threads) t.join();
+            if (as_procs) crashed += shm_supervise(*sm, true);
+            double secs = (double)(now_ns() - start) / 1e9;
+
+            uint64_t moves = 0, attempts = 0;
+            for (int i = 0; i < n; i++) {
+                moves += sm->players()[i].moved; // Só passos que mudaram a posição, como em bench scale e snapshot
+                attempts += sm->players()[i].attempts;
+            }
+            /* Vagas das pontes: livres + ocupadas por vivos tem que dar a capacidade (nenhuma perdida ou duplicada) */
+            bool slots_ok = true;
+            for (int b = 0; b < sm->nbridges; b++) {
+                int free_slots = 0, held = 0;
+                sem_getvalue(&sm->bridges()[b].sem, &free_slots);
+                for (int i = 0; i < n; i++) held += sm->players()[i].bridge == b;
+                slots_ok = slots_ok && free_slots + held == bridge_capacity;
+            }
+            /* Ocupação: os contadores somam os vivos e cada célula conta exatamente os vivos que estão nela
+             * (um passo interrompido não pode deixar fantasma nem estourar um contador) */
+            vector<uint16_t> expected((size_t)grid.rows * grid.cols * 2, 0);
+            int live = 0;
+            for (int i = 0; i < n; i++) {
+                MatchPlayer &p = sm->players()[i];
+                if (!p.alive) continue;
+                live++;
+                expected[((size_t)p.x * grid.cols + p.y) * 2 + (p.symbol == '2')]++;
+            }
+            uint64_t occ_sum = 0;
+            bool occ_ok = true;
+            for (size_t c = 0; c < expected.size(); c++) {
+                uint8_t got = sm->occupants(0, 0)[c];
+                occ_sum += got;
+                occ_ok = occ_ok && got == expected[c];
+            }
+            occ_ok = occ_ok && occ_sum == (uint64_t)live;
+            cout << "players=" << n << " mode=" << mode
+                 << " moves_per_s=" << (uint64_t)((double)moves / secs)
+                 << " attempts_per_s=" << (uint64_t)((double)attempts / secs)
+                 << " shm_bytes=" << sm->bytes
+                 << " bridge_slots_ok=" << (slots_ok ? "yes" : "no") << " occupancy_ok=" << (occ_ok ? "yes" : "no");
+            if (render) cout << " frames_per_s=" << (uint64_t)((double)sm->frames / secs) << " locked_frames=" << sm->locked_frames;
+            if (as_procs && crash_after) {
+                cout << " crashed=" << crashed << " recovered_locks=" << sm->recovered
+                     << " moves_after_crash=" << (crashed ? moves - moves_at_crash : 0);
+            }
+            cout << "\n";
+            shm_destroy(sm);
+        }
+    }
+    destroy_bridges();
+    return 0;
+}
+
+// --- TORNEIO ---
+// Muitas partidas independentes de dois bots no mesmo processo. Cada partida é uma Match numa vaga
+// de uma arena alocada uma vez (C vagas de match_layout(2).bytes): começar uma partida é match_init
+// na vaga (cópia do cenário, sem malloc) e encerrá-la é match_destroy. As vagas são as tarefas do
+// WorkStealingPool: cada passo avança a partida da vaga alguns ticks, e a vaga de uma partida
+// encerrada recebe a próxima da fila até acabarem as partidas do lote.
+
+/* Vaga da arena: a partida em andamento e os bots dela (reaproveitados entre partidas) */
+struct TournamentSlot {
+    Match *m = nullptr;
+    Bot bots[2];
+    long index = -1;      // Partida em andamento (-1 = vaga livre)
+    uint64_t ticks = 0;   // Tentativas de movimento na partida atual
+    /* Resultados acumulados pela vaga; só o worker que está com a vaga escreve */
+    long wins[2] = {0, 0};
+    long draws = 0;
+    uint64_t total_ticks = 0;
+};
+
+struct TournamentConfig {
+    long matches = 1000;
+    int concurrent = 1024;   // Partidas simultâneas (vagas da arena)
+    int workers = 1;
+    uint64_t max_ticks = 2000; // Tentativas por partida antes do empate
+    Bot::Kind kind = Bot::SCRIPT;
+    uint64_t seed = 1;
+};
+
+struct TournamentResult {
+    long wins[2] = {0, 0};
+    long draws = 0;
+    uint64_t ticks = 0;
+    double secs = 0;
+    size_t bytes_per_match = 0; // Bloco da Match na arena + vaga (bots e roteiros)
+    size_t arena_bytes = 0;
+};
+
+/* Roda um lote de partidas. O mapa, as pontes e as regiões já devem estar preparados (reset_map). */
+bool run_tournament(const TournamentConfig &cfg, TournamentResult &res) {
+    static const int QUANTUM = 16; // Rodadas por passo: amortiza a fila do pool
+    MatchLayout layout = match_layout(2);
+    int nslots = (int)min<long>(cfg.concurrent, cfg.matches);
+    size_t arena_bytes = layout.bytes * (size_t)nslots;
+    void *arena = mmap(nullptr, arena_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) return false;
+
+    const MatchStart starts[2] = {{grid.start1_x, grid.start1_y, '1'}, {grid.start2_x, grid.start2_y, '2'}};
+    vector<TournamentSlot> slots(nslots);
+    string script1 = shortest_path_script(grid.start1_x, grid.start1_y, true);
+    string script2 = shortest_path_script(grid.start2_x, grid.start2_y, false);
+    for (TournamentSlot &t : slots) { // Roteiros copiados uma vez por vaga, fora da medição
+        t.bots[0].script = script1;
+        t.bots[1].script = script2;
+        t.bots[0].kind = t.bots[1].kind = cfg.kind;
+    }
+
+    atomic<long> next{0}, done{0};
+    auto step = [&](int s) {
+        TournamentSlot &t = slots[s];
+        if (t.index < 0) { // Vaga livre: começa a próxima partida do lote
+            long idx = next.fetch_add(1, memory_order_relaxed);
+            if (idx >= cfg.matches) return false; // Lote esgotado: a vaga sai do pool
+            t.index = idx;
+            t.ticks = 0;
+            t.m = match_init((char *)arena + (size_t)s * layout.bytes, layout, starts, false);
+            for (int i = 0; i < 2; i++) { // Sementes por partida: o resultado não depende da vaga nem do worker
+                t.bots[i].pos = 0;
+                t.bots[i].rng = (cfg.seed * 2 + 1) * 0x9E3779B97F4A7C15ULL + (uint64_t)idx * 2 + i + 1;
+            }
+        }
+        Match &m = *t.m;
+        for (int q = 0; q < QUANTUM && m.playing.load(memory_order_relaxed) && t.ticks < cfg.max_ticks; q++) {
+            for (int i = 0; i < 2; i++) {
+                MatchPlayer &p = m.players()[i];
+                if (match_move(m, i, t.bots[i].decide(p.x, p.y))) t.bots[i].moved();
+                t.ticks++;
+            }
+        }
+        if (m.playing.load(memory_order_relaxed) && t.ticks < cfg.max_ticks) return true; // Continua no próximo passo
+        int w = m.winner.load();
+        if (w >= 0) t.wins[w]++;
+        else t.draws++;
+        t.total_ticks += t.ticks;
+        match_destroy(t.m);
+        t.m = nullptr;
+        t.index = -1;
+        if (done.fetch_add(1) + 1 == cfg.matches) playing = false; // Última partida do lote: libera os workers
+        return true;
+    };
+
+    vector<int> tasks(nslots);
+    for (int s = 0; s < nslots; s++) tasks[s] = s;
+    WorkStealingPool pool(cfg.workers);
+    playing = true;
+    uint64_t start = now_ns();
+    pool.run(tasks, step);
+    res = TournamentResult();
+    res.secs = (double)(now_ns() - start) / 1e9;
+    for (TournamentSlot &t : slots) {
+        res.wins[0] += t.wins[0];
+        res.wins[1] += t.wins[1];
+        res.draws += t.draws;
+        res.ticks += t.total_ticks;
+    }
+    res.bytes_per_match = layout.bytes + sizeof(TournamentSlot) + script1.capacity() + script2.capacity(); // Bloco + vaga com os bots
+    res.arena_bytes = arena_bytes;
+    munmap(arena, arena_bytes);
+    return true;
+}
+
+/* Lotes de partidas simultâneas: partidas/s e memória por partida */
+static int bench_tournament(int argc, char **argv) {
+    vector<int> batches = {1000, 10000, 100000};
+    TournamentConfig cfg;
+    cfg.workers = max(1, (int)thread::hardware_concurrency());
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--matches" && has_value) ok = parse_list(argv[++i], batches);
+        else if (arg == "--concurrent" && has_value) { cfg.concurrent = atoi(argv[++i]); ok = cfg.concurrent > 0; }
+        else if (arg == "--workers" && has_value) { cfg.workers = atoi(argv[++i]); ok = cfg.workers > 0; }
+        else if (arg == "--max-ticks" && has_value) { cfg.max_ticks = strtoull(argv[++i], nullptr, 10); ok = cfg.max_ticks > 0; }
+        else if (arg == "--seed" && has_value) cfg.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--bot" && has_value) {
+            string k = argv[++i];
+            cfg.kind = k == "random" ? Bot::RANDOM : Bot::SCRIPT;
+            ok = k == "random" || k == "script";
+        }
+        else if (arg == "--map" && has_value) ok = open_map(argv[++i]);
+        else if (parse_bridge_option(argc, argv, i, ok)) {}
+        else ok = false;
+        if (!ok) {
+            cerr << "Uso: " << argv[0] << " tournament [--matches 1000,10000,100000] [--concurrent C] [--workers W]\n"
+                 << "       [--max-ticks N] [--bot script|random] [--seed S] [--map ARQUIVO] [--bridge-capacity N]\n";
+            return 2;
+        }
+    }
+    if (bridge_admission_set) {
+        cerr << "tournament: --bridge-order e --convoy nao se aplicam (a Match usa so o semaforo da ponte)\n";
+        return 2;
+    }
+
+    end_on_win = true;
+    reset_map(); // Pontes e regiões do mapa; cada partida tem as suas na própria Match
+    for (int n : batches) {
+        cfg.matches = n;
+        TournamentResult res;
+        if (!run_tournament(cfg, res)) { perror("mmap"); return 1; }
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        cout << "matches=" << n << " concurrent=" << min<long>(cfg.concurrent, n) << " workers=" << cfg.workers
+             << " p1_wins=" << res.wins[0] << " p2_wins=" << res.wins[1] << " draws=" << res.draws
+             << " matches_per_s=" << (uint64_t)((double)n / res.secs)
+             << " ticks_per_s=" << (uint64_t)((double)res.ticks / res.secs)
+             << " bytes_per_match=" << res.bytes_per_match
+             << " arena_bytes=" << res.arena_bytes
+             << " peak_rss_kb=" << ru.ru_maxrss << "\n";
+    }
+    return 0;
+}
+
+/* Leitores concorrentes do estado (espectadores) durante uma partida de bots no pool: com o
+ * seqlock os movimentos/s dos escritores não devem cair com mais leitores; com --mode lock os
+ * leitores travam as regiões como o desenho original. Cada leitura confere o quadro contra as
+ * posições copiadas: símbolo de jogador numa célula onde nenhum jogador daquele time está é um
+ * fantasma, sinal de cópia rasgada (torn). --mode none copia sem sincronização nenhuma (controle:
+ * mostra que a conferência detecta quadros lidos no meio dos passos). */
+static int bench_snapshot(int argc, char **argv) {
+    vector<int> reader_counts = {0, 1, 2, 4, 8, 16};
+    vector<string> modes = {"seqlock", "lock"};
+    int n = 64, workers = max(1, (int)thread::hardware_concurrency());
+    long duration_ms = 500;
+    long reader_hz = 1000; // Leituras por segundo de cada leitor (0 = sem pausa)
+    uint64_t seed = 1;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--readers" && has_value) ok = parse_list(argv[++i], reader_counts, 0);
+        else if (arg == "--mode" && has_value) {
+            modes.clear();
+            stringstream list(argv[++i]);
+            for (string m; getline(list, m, ',');) {
+                ok = ok && (m == "seqlock" || m == "lock" || m == "none");
+                modes.push_back(m);
+            }
+        }
+        else if (arg == "--players" && has_value) { n = atoi(argv[++i]); ok = n > 0; }
+        else if (arg == "--workers" && has_value) { workers = atoi(argv[++i]); ok = workers > 0; }
+        else if (arg == "--duration-ms" && has_value) duration_ms = atol(argv[++i]);
+        else if (arg == "--reader-hz" && has_value) { reader_hz = atol(argv[++i]); ok = reader_hz >= 0; }
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--tile" && has_value) ok = parse_tile(argv[++i], tile_rows, tile_cols);
+        else if (arg == "--map" && has_value) ok = open_map(argv[++i]);
+        else if (parse_bridge_option(argc, argv, i, ok)) {}
+        else ok = false;
+        if (!ok || duration_ms <= 0) {
+            cerr << "Uso: " << argv[0] << " snapshot [--readers 0,1,2,4,8,16] [--mode seqlock,lock,none] [--players N] [--workers W]\n"
+                 << "       [--duration-ms N] [--reader-hz H] [--seed S] [--tile RxC] [--map ARQUIVO]\n";
+            return 2;
+        }
+    }
+
+    max_ticks = 0;
+    end_on_win = false;
+    if (!grid.text) use_default_map();
+    for (const string &mode : modes) {
+        bool seqlock = mode == "seqlock", locked = mode == "lock";
+        double base_rate = 0;
+        for (int readers : reader_counts) {
+            vector<unique_ptr<Player>> players;
+            vector<unique_ptr<Bot>> bots;
+            reset_map();
+            if (!spawn_bots(players, bots, n, seed)) { cerr << "mapa sem chao livre na metade de um dos times\n"; return 2; }
+            vector<Player *> ps;
+            for (auto &p : players) ps.push_back(p.get());
+            WorkStealingPool pool(workers);
+
+            atomic<uint64_t> reads{0}, retries{0}, torn{0};
+            vector<thread> reader_threads;
+            for (int r = 0; r < readers; r++) {
+                reader_threads.emplace_back([&] {
+                    vector<char> frame((size_t)grid.rows * grid.cols);
+                    vector<pair<int, int>> pos(ps.size());
+                    vector<char> owner(frame.size(), 0); // Símbolo de algum jogador posicionado em cada célula
+                    uint64_t my_reads = 0, my_retries = 0, my_torn = 0;
+                    uint64_t period = reader_hz ? 1000000000ULL / (uint64_t)reader_hz : 0, next = now_ns();
+                    while (playing) {
+                        if (seqlock) {
+                            my_retries += read_view_snapshot(frame.data(), 0, 0, grid.rows, grid.cols, ps.data(), (int)ps.size(), pos.data());
+                        } else { // Leitor original: trava todas as regiões em ordem, copia e solta (none: só copia)
+                            for (int k = 0; locked && k < tiles_y * tiles_x; k++) lock_region(k);
+                            for (int i = 0; i < grid.rows; i++) memcpy(&frame[(size_t)i * grid.cols], &view_at(i, 0), grid.cols);
+                            for (size_t i = 0; i < ps.size(); i++)
+                                pos[i] = {__atomic_load_n(&ps[i]->x, __ATOMIC_RELAXED), __atomic_load_n(&ps[i]->y, __ATOMIC_RELAXED)};
+                            for (int k = tiles_y * tiles_x - 1; locked && k >= 0; k--) unlock_region(k);
+                        }
+                        for (size_t i = 0; i < pos.size(); i++) owner[(size_t)pos[i].first * grid.cols + pos[i].second] |= ps[i]->symbol - '0';
+                        bool ghost = false;
+                        for (size_t c = 0; c < frame.size(); c++)
+                            if ((frame[c] == '1' || frame[c] == '2') && !(owner[c] & (frame[c] - '0'))) ghost = true;
+                        for (auto &xy : pos) owner[(size_t)xy.first * grid.cols + xy.second] = 0;
+                        my_torn += ghost;
+                        my_reads++;
+                        if (period) {
+                            next += period;
+                            uint64_t now = now_ns();
+                            if (next > now) this_thread::sleep_for(chrono::nanoseconds(next - now));
+                            else next = now; // Atrasado: não acumula leituras
+                        }
+                    }
+                    reads += my_reads;
+                    retries += my_retries;
+                    torn += my_torn;
+                });
+            }
+
+            uint64_t start = now_ns();
+            thread timer([duration_ms] {
+                uint64_t end = now_ns() + (uint64_t)duration_ms * 1000000;
+                while (playing && now_ns() < end) this_thread::sleep_for(chrono::milliseconds(1));
+                playing = false;
+            });
+            run_pool_match(players, pool);
+            timer.join();
+            for (auto &t : reader_threads) t.join();
+            double secs = (double)(now_ns() - start) / 1e9;
+            destroy_bridges();
+
+            uint64_t moves = 0, attempts = 0;
+            for (auto &p : players) {
+                moves += p->moved; // Só passos que mudaram a posição, como em bench scale
+                attempts += p->attempts;
+            }
+            double rate = (double)moves / secs;
+            if (readers == reader_counts.front()) base_rate = rate;
+            const LockStats &ls = pool.lock_totals;
+            cout << "mode=" << mode << " readers=" << readers << " players=" << n << " workers=" << workers
+                 << " moves_per_s=" << (uint64_t)rate
+                 << " moves_vs_base=" << (base_rate > 0 ? rate / base_rate : 0.0)
+                 << " attempts_per_s=" << (uint64_t)((double)attempts / secs)
+                 << " reads_per_s=" << (uint64_t)((double)reads / secs)
+                 << " retries_per_read=" << (reads ? (double)retries / (double)reads : 0.0)
+                 << " torn=" << torn;
+            if (stats_enabled) // Só os workers (escritores): os leitores com lock contam no próprio bloco
+                cout << " writer_contended_pct=" << (ls.acquisitions ? 100.0 * (double)ls.contended / (double)ls.acquisitions : 0.0);
+            cout << "\n";
+        }
+    }
+    return 0;
+}
+
+/* Escreve um mapa de funil rows x cols: bordas de parede, fileiras de parede em pente com
+ * passagens de 2 células, uma faixa central de parede atravessada por k pontes verticais 'C'
+ * de largura 2 e as bandeiras em (1, 1) e (rows-2, cols-2). Linha a linha, sem montar o mapa
+ * inteiro na memória. */
+static void write_funnel_map(ostream &out, int rows, int cols, int k, uint64_t seed) {
+    Bot rng; // Reaproveita o xorshift dos bots
+    rng.rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    int band_lo = rows / 2 - 2, band_hi = rows / 2 + 3; // Faixa central de parede: [band_lo, band_hi)
+    string row((size_t)cols, ' ');
+    for (int x = 0; x < rows; x++) {
+        if (x == 0 || x == rows - 1) row.assign((size_t)cols, '#');
+        else if (x >= band_lo && x < band_hi) { // Parede sólida, só as pontes atravessam
+            row.assign((size_t)cols, '#');
+            for (int b = 0; b < k; b++) {
+                int y = (b + 1) * cols / (k + 1) - 1;
+                row[y] = row[y + 1] = 'C';
+            }
+        } else if (x % 4 == 0 && x < rows - 2 && (x < band_lo - 1 || x > band_hi)) { // Pente: passagens a cada 16 colunas
+            row.assign((size_t)cols, '#');
+            for (int y = 1 + (int)(rng.next_random() % 16); y < cols - 1; y += 16) {
+                row[y] = ' ';
+                if (y + 1 < cols - 1) row[y + 1] = ' ';
+            }
+        } else {
+            row.assign((size_t)cols, ' ');
+            row[0] = row[cols - 1] = '#';
+        }
+        if (x == 1) row[1] = 'F';               // Largada do Jogador 1 / bandeira do Jogador 2
+        if (x == rows - 2) row[cols - 2] = 'F'; // Largada do Jogador 2 / bandeira do Jogador 1
+        out << row << '\n';
+    }
+}
+
+/* Gera um mapa grande em arquivo para os benchmarks e o jogo (--map) */
+static int bench_gen_map(int argc, char **argv) {
+    int rows = 0, cols = 0, k = 1;
+    uint64_t seed = 1;
+    string out_path;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--rows" && has_value) rows = atoi(argv[++i]);
+        else if (arg == "--cols" && has_value) cols = atoi(argv[++i]);
+        else if (arg == "--bridges" && has_value) k = atoi(argv[++i]);
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--out" && has_value) out_path = argv[++i];
+        else rows = -1;
+    }
+    if (rows < 12 || cols < 20 || k < 1 || 3 * k > cols - 2 || out_path.empty()) {
+        cerr << "Uso: " << argv[0] << " gen-map --rows R --cols C [--bridges K] [--seed S] --out ARQUIVO\n"
+             << "  R >= 12, C >= 20, 1 <= K <= (C-2)/3\n";
+        return 2;
+    }
+    ofstream out(out_path, ios::binary);
+    write_funnel_map(out, rows, cols, k, seed);
+    out.close();
+    if (!out) { cerr << "falha ao escrever " << out_path << "\n"; return 1; }
+    cout << "map=" << out_path << " rows=" << rows << " cols=" << cols << " bridges=" << k
+         << " bytes=" << (uint64_t)rows * (cols + 1) << "\n";
+    return 0;
+}
+
+/* Gera um funil size x size com k pontes num arquivo temporário e o carrega como mapa atual.
+ * O arquivo é apagado em seguida: a grade guarda o descritor e reset_view remapeia por ele. */
+static bool load_funnel_map(int size, int k, uint64_t seed) {
+    char tmp[] = "/tmp/bench-map-XXXXXX";
+    int fd = mkstemp(tmp);
+    if (fd < 0) { perror("mkstemp"); return false; }
+    close(fd);
+    {
+        ofstream out(tmp, ios::binary);
+        write_funnel_map(out, size, size, k, seed);
+    }
+    string err;
+    bool ok = load_map(tmp, err);
+    if (!ok) cerr << err << "\n";
+    unlink(tmp);
+    return ok;
+}
+
+/* Compara o layout antigo da grade lógica (duas matrizes de char: base_map + map_view, 2 bytes
+ * por célula) com as camadas compactas (1 bit de parede + 2 bits de terreno por célula).
+ * Agentes em passeio aleatório fazem a mesma consulta do move_player (parede no destino,
+ * terreno do destino) com a mesma sequência de sorteios nos dois layouts. */
+static int bench_layout(int argc, char **argv) {
+    long agents = 4096, steps = 20000000;
+    uint64_t seed = 1;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--map" && has_value) ok = open_map(argv[++i]);
+        else if (arg == "--agents" && has_value) agents = atol(argv[++i]);
+        else if (arg == "--steps" && has_value) steps = atol(argv[++i]);
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else ok = false;
+        if (!ok || agents <= 0 || steps <= 0) {
+            cerr << "Uso: " << argv[0] << " layout [--map ARQUIVO] [--agents N] [--steps N] [--seed S]\n";
+            return 2;
+        }
+    }
+    if (!grid.text) use_default_map();
+    const int rows = grid.rows, cols = grid.cols;
+
+    vector<char> legacy_base((size_t)rows * cols), legacy_view((size_t)rows * cols); // Layout antigo
+    for (int x = 0; x < rows; x++) {
+        memcpy(&legacy_base[(size_t)x * cols], grid.text + (size_t)x * grid.stride, (size_t)cols);
+        memcpy(&legacy_view[(size_t)x * cols], grid.text + (size_t)x * grid.stride, (size_t)cols);
+    }
+
+    vector<pair<int, int>> start((size_t)agents);
+    Bot placer;
+    placer.rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    for (auto &a : start) { // Agentes espalhados por células livres do mapa todo
+        do {
+            a.first = (int)(placer.next_random() % rows);
+            a.second = (int)(placer.next_random() % cols);
+        } while (is_wall(a.first, a.second));
+    }
+
+    /* Passeio aleatório; blocked(x, y) e kind(x, y) são as consultas do layout medido */
+    auto walk = [&](auto blocked, auto kind, uint64_t &moves, uint64_t &checksum) {
+        vector<pair<int, int>> pos = start;
+        Bot rng;
+        rng.rng = seed * 0x9E3779B97F4A7C15ULL + 2;
+        const int dx[4] = {-1, 1, 0, 0}, dy[4] = {0, 0, -1, 1};
+        moves = checksum = 0;
+        uint64_t t0 = now_ns();
+        for (long s = 0; s < steps; s++) {
+            auto &p = pos[(size_t)(s % agents)];
+            int d = (int)(rng.next_random() & 3);
+            int nx = p.first + dx[d], ny = p.second + dy[d];
+            if (nx < 0 || nx >= rows || ny < 0 || ny >= cols || blocked(nx, ny)) continue;
+            checksum += (uint64_t)kind(nx, ny); // Ponte / bandeira no destino, como no move_player
+            p.first = nx;
+            p.second = ny;
+            moves++;
+        }
+        return (double)(now_ns() - t0) / 1e9;
+    };
+
+    uint64_t legacy_moves, legacy_sum, packed_moves, packed_sum;
+    double legacy_s = walk([&](int x, int y) { return legacy_view[(size_t)x * cols + y] == '#'; },
+                           [&](int x, int y) { return legacy_base[(size_t)x * cols + y] == 'C' ? 1 : legacy_base[(size_t)x * cols + y] == 'F' ? 2 : 0; },
+                           legacy_moves, legacy_sum);
+    double packed_s = walk([](int x, int y) { return is_wall(x, y); },
+                           [](int x, int y) { return (int)terrain_at(x, y) & 3; },
+                           packed_moves, packed_sum);
+    bool same = legacy_moves == packed_moves && legacy_sum == packed_sum; // Mesmos caminhos nos dois layouts
+
+    cout << "map=" << rows << "x" << cols << " agents=" << agents << " steps=" << steps << "\n"
+         << "legacy_bytes=" << legacy_base.size() + legacy_view.size() << "\n"
+         << "packed_bytes=" << grid_layer_bytes() << "\n"
+         << "legacy_moves_per_s=" << (uint64_t)((double)steps / legacy_s) << "\n"
+         << "packed_moves_per_s=" << (uint64_t)((double)steps / packed_s) << "\n"
+         << "speedup=" << legacy_s / packed_s << "\n"
+         << "same_walk=" << (same ? "yes" : "no") << "\n";
+    return same ? 0 : 1;
+}
+
+/* Microbenchmarks dos bitboards em mapas de funil size x size: colisão por movimento (matriz de
+ * char x bit a bit escalar x lote AVX2) e inundação do mapa inteiro (BFS célula a célula x
+ * varredura bit-paralela escalar x AVX2). Os três caminhos precisam dar o mesmo resultado. */
+static int bench_bitboard(int argc, char **argv) {
+    vector<int> sizes = {64, 256, 1024, 4096};
+    long queries = 1 << 22, fills = 5;
+    uint64_t seed = 1;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--sizes" && has_value) ok = parse_list(argv[++i], sizes);
+        else if (arg == "--queries" && has_value) queries = atol(argv[++i]);
+        else if (arg == "--fills" && has_value) fills = atol(argv[++i]);
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else ok = false;
+        if (!ok || queries <= 0 || fills <= 0) {
+            cerr << "Uso: " << argv[0] << " bitboard [--sizes 64,256,1024,4096] [--queries N] [--fills N] [--seed S]\n";
+            return 2;
+        }
+    }
+    bool simd = cpu_has_avx2();
+    cout << "avx2=" << (simd ? "yes" : "no") << "\n";
+    for (int size : sizes) {
+        size = max(size, 20); // Menor funil que o gerador aceita
+        if (!load_funnel_map(size, max(1, size / 256), seed)) return 1;
+        const int rows = grid.rows, cols = grid.cols;
+        vector<char> legacy((size_t)rows * cols); // Matriz de char do layout antigo
+        for (int x = 0; x < rows; x++) memcpy(&legacy[(size_t)x * cols], grid.text + (size_t)x * grid.stride, (size_t)cols);
+
+        /* Colisão: destinos aleatórios, incluindo a moldura fora do mapa */
+        vector<int32_t> xs((size_t)queries), ys((size_t)queries);
+        Bot rng;
+        rng.rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+        for (long q = 0; q < queries; q++) {
+            xs[q] = (int32_t)(rng.next_random() % (uint32_t)(rows + 2)) - 1;
+            ys[q] = (int32_t)(rng.next_random() % (uint32_t)(cols + 2)) - 1;
+        }
+        vector<uint8_t> out_legacy((size_t)queries), out_bits((size_t)queries), out_simd((size_t)queries);
+        uint64_t t0 = now_ns();
+        for (long q = 0; q < queries; q++) {
+            int x = xs[q], y = ys[q];
+            out_legacy[q] = x < 0 || x >= rows || y < 0 || y >= cols || legacy[(size_t)x * cols + y] == '#';
+        }
+        uint64_t t1 = now_ns();
+        use_simd = false;
+        blocked_batch(xs.data(), ys.data(), (size_t)queries, out_bits.data());
+        uint64_t t2 = now_ns();
+        use_simd = simd;
+        blocked_batch(xs.data(), ys.data(), (size_t)queries, out_simd.data());
+        uint64_t t3 = now_ns();
+        bool same = out_legacy == out_bits && out_bits == out_simd;
+
+        /* Inundação a partir da largada do Jogador 1 */
+        size_t bfs_cells = 0, bits_cells = 0, simd_cells = 0;
+        vector<uint8_t> seen;
+        vector<int> frontier;
+        uint64_t t4 = now_ns();
+        for (long f = 0; f < fills; f++) {
+            seen.assign((size_t)rows * cols, 0);
+            frontier.assign(1, grid.start1_x * cols + grid.start1_y);
+            seen[frontier[0]] = 1;
+            for (size_t head = 0; head < frontier.size(); head++) {
+                int cur = frontier[head], x = cur / cols, y = cur % cols;
+                const int dx[4] = {-1, 1, 0, 0}, dy[4] = {0, 0, -1, 1};
+                for (int k = 0; k < 4; k++) {
+                    int nx = x + dx[k], ny = y + dy[k];
+                    if (nx < 0 || nx >= rows || ny < 0 || ny >= cols) continue;
+                    int next = nx * cols + ny;
+                    if (seen[next] || legacy[next] == '#') continue;
+                    seen[next] = 1;
+                    frontier.push_back(next);
+                }
+            }
+            bfs_cells = frontier.size();
+        }
+        uint64_t t5 = now_ns();
+        vector<uint64_t> reach;
+        use_simd = false;
+        for (long f = 0; f < fills; f++) bits_cells = flood_fill(grid.start1_x, grid.start1_y, reach);
+        uint64_t t6 = now_ns();
+        use_simd = simd;
+        for (long f = 0; f < fills; f++) simd_cells = flood_fill(grid.start1_x, grid.start1_y, reach);
+        uint64_t t7 = now_ns();
+        same = same && bfs_cells == bits_cells && bits_cells == simd_cells;
+
+        cout << "size=" << rows << "x" << cols
+             << " check_char_ns=" << (double)(t1 - t0) / queries
+             << " check_bits_ns=" << (double)(t2 - t1) / queries
+             << " check_simd_ns=" << (double)(t3 - t2) / queries
+             << " fill_bfs_ms=" << (double)(t5 - t4) / fills / 1e6
+             << " fill_bits_ms=" << (double)(t6 - t5) / fills / 1e6
+             << " fill_simd_ms=" << (double)(t7 - t6) / fills / 1e6
+             << " reached=" << bits_cells << " same=" << (same ? "yes" : "no") << "\n";
+        if (!same) return 1;
+    }
+    return 0;
+}
+
+/* Microbenchmark dos campos de distância: construção completa, reparo incremental quando uma ponte
+ * enche/esvazia (conferido contra uma construção do zero) e custo por decisão com B bots. */
+static int bench_field(int argc, char **argv) {
+    vector<int> sizes = {256, 1024, 4096};
+    vector<int> bot_counts = {16, 256, 4096};
+    long decisions = 4000000;
+    int k = 4;
+    uint64_t seed = 1;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--sizes" && has_value) ok = parse_list(argv[++i], sizes);
+        else if (arg == "--bots" && has_value) ok = parse_list(argv[++i], bot_counts);
+        else if (arg == "--decisions" && has_value) decisions = atol(argv[++i]);
+        else if (arg == "--bridges" && has_value) k = atoi(argv[++i]);
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else ok = false;
+        if (!ok || decisions <= 0 || k < 1) {
+            cerr << "Uso: " << argv[0] << " field [--sizes 256,1024,4096] [--bots 16,256,4096] [--decisions N] [--bridges K] [--seed S]\n";
+            return 2;
+        }
+    }
+    end_on_win = false;
+    for (int size : sizes) {
+        size = max(size, 3 * k + 2 < 20 ? 20 : 3 * k + 2);
+        if (!load_funnel_map(size, k, seed)) return 1;
+        setup_bridges(); // Pontes do mapa novo
+        reset_map();
+        setup_fields();
+        DistanceField &f = *team_fields[0];
+        f.sync(); // Nenhuma ponte cheia: sem reparo
+        double build_ms = (double)(team_fields[0]->build_ns + team_fields[1]->build_ns) / 2 / 1e6;
+
+        /* Reparo: enche a ponte 0 (como se o semáforo estivesse sem vagas), depois esvazia */
+        auto set_occupancy = [](int b, int occ) {
+            lock_guard<mutex> g(bridges[b]->m);
+            bridges[b]->occupancy = occ;
+            bridge_epoch.fetch_add(1, memory_order_relaxed);
+        };
+        auto same_as_fresh = [&f]() { // Reparado == construído do zero com as mesmas pontes cheias
+            DistanceField fresh;
+            fresh.target_right = f.target_right;
+            fresh.copy_blocked(f);
+            fresh.build();
+            for (size_t c = 0; c < f.cells; c++)
+                if (fresh.at(c) != f.at(c)) return false;
+            return true;
+        };
+        set_occupancy(0, bridges[0]->capacity);
+        uint64_t cells0 = f.repaired_cells, t0 = now_ns();
+        f.sync();
+        uint64_t t1 = now_ns(), block_cells = f.repaired_cells - cells0;
+        bool same = same_as_fresh();
+        set_occupancy(0, 0);
+        cells0 = f.repaired_cells;
+        uint64_t t2 = now_ns();
+        f.sync();
+        uint64_t t3 = now_ns(), unblock_cells = f.repaired_cells - cells0;
+        same = same && same_as_fresh();
+
+        cout << "size=" << grid.rows << "x" << grid.cols << " bridges=" << bridges.size()
+             << " field_bytes=" << f.cells * sizeof(uint32_t)
+             << " build_ms=" << build_ms
+             << " block_repair_ms=" << (double)(t1 - t0) / 1e6 << " block_cells=" << block_cells
+             << " unblock_repair_ms=" << (double)(t3 - t2) / 1e6 << " unblock_cells=" << unblock_cells
+             << " same=" << (same ? "yes" : "no") << "\n";
+        if (!same) return 1;
+
+        /* Decisão: B bots espalhados, cada um pergunta o próximo passo e anda (sem o motor) */
+        for (int n : bot_counts) {
+            vector<unique_ptr<Player>> players;
+            vector<unique_ptr<Bot>> bots;
+            reset_map();
+            if (!spawn_bots(players, bots, n, seed)) { cerr << "mapa sem chao livre na metade de um dos times\n"; return 2; }
+            for (size_t i = 0; i < bots.size(); i++) {
+                bots[i]->kind = Bot::FIELD;
+                bots[i]->field = team_fields[i % 2].get();
+            }
+            uint64_t start = now_ns();
+            for (long d = 0; d < decisions; d++) {
+                Player &p = *players[(size_t)d % players.size()];
+                char dir = p.bot->decide(p.x, p.y);
+                int nx = p.x + (dir == 'd') - (dir == 'u'), ny = p.y + (dir == 'r') - (dir == 'l');
+                if (!is_wall(nx, ny)) { p.x = nx; p.y = ny; }
+            }
+            double ns = (double)(now_ns() - start) / (double)decisions;
+            long arrived = 0;
+            for (auto &p : players) arrived += team_fields[p->symbol == '2']->at((size_t)p->x * grid.cols + p->y) == 0;
+            cout << "  bots=" << n << " decision_ns=" << ns << " at_flag=" << arrived << "\n";
+        }
+        destroy_bridges();
+    }
+    return 0;
+}
+
+/* Reproduz um corpus de replays na velocidade máxima, conferindo o estado final de cada um.
+ * Serve de suíte de regressão (código de saída 1 se algum divergir) e de desempenho. */
+static int bench_replay(int argc, char **argv) {
+    long repeat = 1;
+    vector<string> files;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--repeat" && has_value) repeat = atol(argv[++i]);
+        else if (arg == "--map" && has_value) { if (!open_map(argv[++i])) return 2; }
+        else if (arg.size() > 1 && arg[0] == '-') repeat = 0;
+        else files.push_back(arg);
+    }
+    if (repeat <= 0 || files.empty()) {
+        cerr << "Uso: " << argv[0] << " replay [--map ARQUIVO] [--repeat N] REPLAY...\n";
+        return 2;
+    }
+    if (!grid.text) use_default_map();
+    vector<vector<uint8_t>> corpus(files.size());
+    uint64_t bytes = 0;
+    for (size_t f = 0; f < files.size(); f++) {
+        if (!read_file(files[f], corpus[f])) { cerr << "nao foi possivel ler " << files[f] << "\n"; return 2; }
+        bytes += corpus[f].size();
+    }
+
+    uint64_t events = 0, failures = 0;
+    vector<bool> failed(files.size(), false);
+    ReplayResult res;
+    uint64_t start = now_ns();
+    for (long r = 0; r < repeat; r++) {
+        for (size_t f = 0; f < files.size(); f++) {
+            bool ok = play_replay(corpus[f], res);
+            events += res.events;
+            if (ok) continue;
+            failures++;
+            if (!failed[f]) cerr << "FALHOU " << files[f] << ": " << res.err << "\n"; // Uma vez por arquivo
+            failed[f] = true;
+        }
+    }
+    double secs = (double)(now_ns() - start) / 1e9;
+    destroy_bridges();
+
+    uint64_t replays = (uint64_t)repeat * files.size();
+    cout << "replays=" << replays << " files=" << files.size() << " failures=" << failures << "\n"
+         << "corpus_bytes=" << bytes << "\n"
+         << "bytes_per_event=" << (events ? (double)bytes * repeat / events : 0.0) << "\n"
+         << "elapsed_s=" << secs << "\n"
+         << "replays_per_s=" << (double)replays / secs << "\n"
+         << "events_per_s=" << (double)events / secs << "\n";
+    return failures ? 1 : 0;
+}
+
+/* Casos fixos de comboio no mapa embutido (ponte vertical nas colunas 29-30, linhas 7 a 13): dois
+ * jogadores entram um depois do outro com --convoy e duas vagas. Quem entra pela mesma lateral, em
+ * qualquer linha (inclusive a do meio da ponte), segue no mesmo comboio; pontas opostas, laterais
+ * opostas ou lateral x ponta nunca dividem a ponte. Código de saída 1 se algum caso falhar. */
+static int bench_convoy(int argc, char **argv) {
+    if (argc > 2) {
+        cerr << "Uso: " << argv[0] << " convoy\n";
+        return 2;
+    }
+    struct Case {
+        const char *name;
+        int ax, ay; char adir; // Primeiro a entrar (abre o comboio)
+        int bx, by; char bdir; // Segundo: entra junto?
+        bool share;
+    };
+    const Case cases[] = {
+        {"left_side", 7, 28, 'r', 11, 28, 'r', true},
+        {"left_side_mid_row", 7, 28, 'r', 10, 28, 'r', true},
+        {"right_side", 9, 31, 'l', 13, 31, 'l', true},
+        {"top_end", 6, 29, 'd', 6, 30, 'd', true},
+        {"opposite_ends", 6, 29, 'd', 14, 30, 'u', false},
+        {"opposite_sides", 9, 28, 'r', 9, 31, 'l', false},
+        {"mid_row_side_vs_bottom", 10, 28, 'r', 14, 29, 'u', false},
+    };
+    use_default_map();
+    bridge_capacity = 2;
+    convoy_batch = 2;
+    bridge_order = ORDER_FIFO;
+    end_on_win = false;
+    int failures = 0;
+    for (const Case &c : cases) {
+        reset_map();
+        Player a = {c.ax, c.ay, '1', ' '};
+        Player b = {c.bx, c.by, '2', ' '};
+        place_player(a, c.ax, c.ay);
+        place_player(b, c.bx, c.by);
+        a.direction = c.adir;
+        b.direction = c.bdir;
+        bool entered_a = move_player(a);
+        bool shared = entered_a && move_player(b);
+        bool ok = entered_a && shared == c.share;
+        failures += !ok;
+        cout << "case=" << c.name << " first=" << c.adir << " second=" << c.bdir << " shared=" << (shared ? "yes" : "no")
+             << " expected=" << (c.share ? "yes" : "no") << (ok ? "" : " FALHOU") << "\n";
+    }
+    destroy_bridges();
+    cout << "convoy_cases_ok=" << (failures ? "no" : "yes") << "\n";
+    return failures ? 1 : 0;
+}
+
+/* Produtor de rajadas (--burst): a main decide pelo bot como se fosse o teclado, a partir da posição
+ * publicada pela thread do jogador. Um roteiro (SCRIPT) só pode avançar quando o passo acontece de fato,
+ * como em step_player; por isso cada passo do roteiro vai sozinho para a fila e a main espera o resultado
+ * antes do próximo. Passeio aleatório e campo de distâncias não guardam progresso e enchem a fila à vontade. */
+struct BurstFeed {
+    bool pending = false; // Passo do roteiro na fila, ainda não processado
+    uint32_t step = 0;    // Player::steps no momento do envio
+    uint64_t at = 0;      // Posição no momento do envio
+};
+
+int burst_push(Player &p, Bot &b, BurstFeed &f, uint64_t t) {
+    if (f.pending) {
+        if (p.steps.load(memory_order_acquire) == f.step) return 0; // Ainda na fila: nada de novo a decidir
+        f.pending = false;
+        if (p.seen.load(memory_order_relaxed) != f.at) b.moved(); // Só um movimento bem-sucedido muda a posição
+    }
+    uint32_t step = p.steps.load(memory_order_acquire);
+    uint64_t at = p.seen.load(memory_order_relaxed);
+    bool script = b.kind == Bot::SCRIPT && b.pos < b.script.size();
+    if (!p.input.push({b.decide((int)(at >> 32), (int)(uint32_t)at), t})) return 0;
+    if (script) f = {true, step, at};
+    return 1;
+}
+
+/* Main do modo headless: roda as partidas e reporta vazão e latência */
+int main(int argc, char **argv) {
+    if (argc > 1 && string(argv[1]) == "events") return bench_events(argc, argv);
+    if (argc > 1 && string(argv[1]) == "scale") return bench_scale(argc, argv);
+    if (argc > 1 && string(argv[1]) == "procs") return bench_procs(argc, argv);
+    if (argc > 1 && string(argv[1]) == "tournament") return bench_tournament(argc, argv);
+    if (argc > 1 && string(argv[1]) == "snapshot") return bench_snapshot(argc, argv);
+    if (argc > 1 && string(argv[1]) == "gen-map") return bench_gen_map(argc, argv);
+    if (argc > 1 && string(argv[1]) == "layout") return bench_layout(argc, argv);
+    if (argc > 1 && string(argv[1]) == "bitboard") return bench_bitboard(argc, argv);
+    if (argc > 1 && string(argv[1]) == "replay") return bench_replay(argc, argv);
+    if (argc > 1 && string(argv[1]) == "field") return bench_field(argc, argv);
+    if (argc > 1 && string(argv[1]) == "convoy") return bench_convoy(argc, argv);
+
+    long matches = 10000;
+    Bot::Kind kind = Bot::SCRIPT;
+    bool kind_set = false;  // --bot explícito (senão --burst troca o padrão por random)
+    uint64_t seed = 1;
+    max_ticks = 100000;
+    bool render = false;
+    int burst = 0;          // 0 = bots decidem dentro da thread do jogador
+    long burst_gap_us = 1000;
+    int move_delay = 0;
+    string record_dir;      // --record: um replay por partida
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--matches" && has_value) matches = atol(argv[++i]);
+        else if (arg == "--max-ticks" && has_value) max_ticks = atol(argv[++i]);
+        else if (arg == "--seed" && has_value) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--render") render = true;
+        else if (arg == "--render-locks") { render = true; snapshot_reads = false; }
+        else if (arg == "--burst" && has_value) burst = atoi(argv[++i]);
+        else if (arg == "--burst-gap-us" && has_value) burst_gap_us = atol(argv[++i]);
+        else if (arg == "--move-delay" && has_value) move_delay = atoi(argv[++i]);
+        else if (arg == "--map" && has_value) { if (!open_map(argv[++i])) return 2; }
+        else if (arg == "--record" && has_value) record_dir = argv[++i];
+        else if (arg == "--coalesce" && has_value) {
+            if (!parse_coalesce(argv[++i], coalesce_policy)) { usage(argv[0]); return 2; }
+        }
+        else if (parse_bridge_option(argc, argv, i, ok) || parse_stats_option(argc, argv, i, ok)) {
+            if (!ok) { usage(argv[0]); return 2; }
+        }
+        else if (arg == "--bot" && has_value) {
+            string k = argv[++i];
+            if (k == "script") kind = Bot::SCRIPT;
+            else if (k == "random") kind = Bot::RANDOM;
+            else if (k == "field") kind = Bot::FIELD;
+            else { usage(argv[0]); return 2; }
+            kind_set = true;
+        }
+        else { usage(argv[0]); return 2; }
+    }
+    if (matches <= 0 || burst < 0 || move_delay < 0) { usage(argv[0]); return 2; }
+    if (burst && !kind_set) kind = Bot::RANDOM; // Roteiros enviam um passo por vez: a rajada nunca passaria de 1
+
+    move_delay_ms = move_delay; // Por padrão sem pausas: mede apenas o custo da lógica e da sincronização
+    idle_delay_ms = 0;
+
+    Player p1 = {1, 1, '1', ' '};
+    Player p2 = {19, 58, '2', ' '};
+    Histogram lat1, lat2, lat, ilat1, ilat2, ilat;
+    p1.move_lat = &lat1;
+    p2.move_lat = &lat2;
+    p1.input_lat = &ilat1;
+    p2.input_lat = &ilat2;
+    uint64_t pushed = 0, dropped = 0, coalesced = 0, bursts = 0;
+    if (!grid.text) use_default_map();
+    string script1 = shortest_path_script(grid.start1_x, grid.start1_y, true);
+    string script2 = shortest_path_script(grid.start2_x, grid.start2_y, false);
+
+    long wins1 = 0, wins2 = 0, draws = 0, total_ticks = 0;
+    StatsDumper dumper;
+    if (!start_stats_dump(dumper)) return 2;
+    uint64_t start = now_ns();
+    for (long m = 0; m < matches; m++) {
+        Bot b1, b2;
+        b1.kind = b2.kind = kind;
+        b1.script = script1;
+        b2.script = script2;
+        b1.rng = (seed * 2 + 1) * 0x9E3779B97F4A7C15ULL + (uint64_t)m * 2 + 1; // Sementes distintas e não nulas
+        b2.rng = (seed * 2 + 1) * 0x9E3779B97F4A7C15ULL + (uint64_t)m * 2 + 2;
+        p1.bot = burst ? nullptr : &b1; // Com --burst os bots ficam com a main (produtora da fila)
+        p2.bot = burst ? nullptr : &b2;
+        reset_match(p1, p2);
+        if (kind == Bot::FIELD && !team_fields[0]) setup_fields(); // Campos construídos uma vez, reparados a cada partida
+        b1.field = team_fields[0].get();
+        b2.field = team_fields[1].get();
+        ReplayRecorder rec;
+        if (!record_dir.empty()) {
+            rec.begin({&p1, &p2}, seed);
+            recorder = &rec;
+        }
+
+        BurstFeed f1, f2;
+        thread t1(thread_player, ref(p1));
+        thread t2(thread_player, ref(p2));
+        while ((render || burst) && playing) { // A main faz o papel da thread de teclado/desenho, como no jogo
+            if (burst) {
+                for (int k = 0; k < burst && playing; k++) { // Rajada de teclas: mais rápida que o ritmo de movimento
+                    uint64_t t = now_ns();
+                    pushed += burst_push(p1, b1, f1, t) + burst_push(p2, b2, f2, t);
+                }
+                bursts++;
+            }
+            if (render) draw_map();
+            if (burst && burst_gap_us) this_thread::sleep_for(chrono::microseconds(burst_gap_us));
+        }
+        if (render) draw_map(); // Quadro final
+        t1.join();
+        t2.join();
+        if (recorder) {
+            char name[32];
+            snprintf(name, sizeof(name), "/match-%06ld.rsr", m);
+            if (!rec.finish(record_dir + name)) { cerr << "falha ao gravar em " << record_dir << "\n"; return 1; }
+            recorder = nullptr;
+        }
+        destroy_bridges();
+        dropped += p1.input.dropped + p2.input.dropped;
+        coalesced += p1.input.coalesced + p2.input.coalesced;
+
+        total_ticks += p1.attempts + p2.attempts;
+        if (winner_msg.empty()) draws++;
+        else if (winner_msg == "PLAYER 1 VENCEU!") wins1++;
+        else wins2++;
+    }
+    double secs = (double)(now_ns() - start) / 1e9;
+    dumper.stop();
+    lat.merge(lat1);
+    lat.merge(lat2);
+    ilat.merge(ilat1);
+    ilat.merge(ilat2);
+
+    cout << "matches=" << matches << " p1_wins=" << wins1 << " p2_wins=" << wins2 << " draws=" << draws << "\n"
+         << "elapsed_s=" << secs << "\n"
+         << "matches_per_s=" << (double)matches / secs << "\n"
+         << "ticks_per_s=" << (double)total_ticks / secs << "\n"
+         << "move_latency_p50_ns=" << lat.percentile(50) << "\n"
+         << "move_latency_p99_ns=" << lat.percentile(99) << "\n"
+         << "move_latency_max_ns=" << lat.max_value << "\n";
+    print_bridge_stats(cout);
+    if (burst) {
+        cout << "bot=" << (kind == Bot::SCRIPT ? "script" : kind == Bot::RANDOM ? "random" : "field") << "\n"
+             << "commands_pushed=" << pushed << "\n"
+             << "commands_per_burst=" << (bursts ? (double)pushed / (2.0 * bursts) : 0.0) << "\n" // Por jogador: 1 = sem rajada de fato
+             << "lost_moves=" << dropped << "\n"
+             << "coalesced=" << coalesced << "\n"
+             << "input_latency_p50_ns=" << ilat.percentile(50) << "\n"
+             << "input_latency_p99_ns=" << ilat.percentile(99) << "\n";
+    }
+    if (render && render_stats.frames) {
+        const char *label = snapshot_reads ? "render_copy" : "render_lock_hold"; // Sem lock não há posse a medir
+        cout << "frames=" << render_stats.frames << "\n"
+             << "cells_per_frame=" << (double)render_stats.cells / render_stats.frames << "\n"
+             << "bytes_per_frame=" << (double)render_stats.bytes / render_stats.frames << "\n"
+             << label << "_p50_ns=" << render_stats.copy.percentile(50) << "\n"
+             << label << "_p99_ns=" << render_stats.copy.percentile(99) << "\n"
+             << "render_retries=" << render_stats.retries << "\n";
+    }
+    return 0;
+}
+#endif // HEADLESS